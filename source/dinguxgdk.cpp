@@ -31,6 +31,20 @@ const int SOUND_CHANNELS=2;
 const unsigned char GAMEPAD_PRESS=1;
 const unsigned char GAMEPAD_RELEASE=0;
 const size_t BUTTON_AMOUNT=16;
+const unsigned long int PAGE_LIMIT=3;
+const size_t DIRTY_LIMIT=16;
+const size_t BACKGROUND_CACHE_LIMIT=1048576;
+const unsigned int BLEND_MASK=0x07E0F81F;
+const long int AFFINE_ONE=65536;
+const unsigned long int MASK_BITS=32;
+const double PI=3.14159265358979323846;
+const size_t SINK_BUFFER_LENGTH=8192;
+const char FRAMEBUFFER_DEVICE[]="/dev/fb0";
+const char SOUND_DEVICE[]="/dev/dsp";
+const char MIXER_DEVICE[]="/dev/mixer";
+const char GAMEPAD_DEVICE[]="/dev/event0";
+const char BACKLIGHT_DEVICE[]="/proc/jz/lcd_backlight";
+const char MEMORY_DEVICE[]="memory";
 
 namespace OSS_BACKEND
 {
@@ -38,6 +52,9 @@ namespace OSS_BACKEND
  volatile size_t sound_buffer_length=0;
  volatile bool run_stream=true;
  volatile bool do_play=false;
+ volatile bool sound_file=false;
+ volatile unsigned long int sound_rate=0;
+ volatile size_t sound_written=0;
 }
 
 namespace DINGUXGDK
@@ -50,2122 +67,5551 @@ void* oss_play_sound(void *buffer)
   if (OSS_BACKEND::do_play)
   {
    write(OSS_BACKEND::sound_device,buffer,OSS_BACKEND::sound_buffer_length);
+   if (OSS_BACKEND::sound_file) OSS_BACKEND::sound_written+=OSS_BACKEND::sound_buffer_length;
    OSS_BACKEND::do_play=false;
   }
 
  }
  if (buffer!=NULL) free(buffer);
- if (OSS_BACKEND::sound_device!=-1) close(OSS_BACKEND::sound_device);
+ if (OSS_BACKEND::sound_device!=-1)
+ {
+  if (OSS_BACKEND::sound_file) oss_write_head(OSS_BACKEND::sound_device,OSS_BACKEND::sound_rate,OSS_BACKEND::sound_written);
+  close(OSS_BACKEND::sound_device);
+ }
  return NULL;
 }
 
-void Halt(const char *message)
-{
- puts(message);
- exit(EXIT_FAILURE);
-}
-
-Frame::Frame()
+void oss_write_head(const int device,const unsigned long int rate,const size_t length)
 {
- frame_width=0;
- frame_height=0;
- pixels=0;
- length=0;
- buffer=NULL;
- shadow=NULL;
+ WAVE_head head;
+ memset(&head,0,44);
+ memmove(head.riff_signature,"RIFF",4);
+ head.riff_length=36+length;
+ memmove(head.wave_signature,"WAVE",4);
+ memmove(head.format,"fmt ",4);
+ head.description_length=16;
+ head.type=1;
+ head.channels=SOUND_CHANNELS;
+ head.rate=rate;
+ head.block_length=rate*SOUND_CHANNELS*2;
+ head.align=SOUND_CHANNELS*2;
+ head.bits=16;
+ memmove(head.date_signature,"data",4);
+ head.date_length=length;
+ lseek(device,0,SEEK_SET);
+ write(device,&head,44);
+ lseek(device,0,SEEK_END);
+}
+
+void* present_frames(void *target)
+{
+ static_cast<Render*>(target)->run_presenter();
+ return NULL;
 }
 
-Frame::~Frame()
+struct RGB565_Pixel
 {
- if (buffer!=NULL)
- {
-  delete[] buffer;
-  buffer=NULL;
- }
- if (shadow!=NULL)
+ typedef unsigned short int pixel;
+ static pixel convert(const unsigned short int source)
  {
-  delete[] shadow;
-  shadow=NULL;
+  return source;
  }
 
-}
+};
 
-void Frame::calculate_buffer_length()
+struct RGB555_Pixel
 {
- pixels=static_cast<size_t>(frame_width)*static_cast<size_t>(frame_height);
- length=pixels*sizeof(unsigned short int);
-}
+ typedef unsigned short int pixel;
+ static pixel convert(const unsigned short int source)
+ {
+  return ((source>>1)&0x7FE0)|(source&0x001F);
+ }
 
-unsigned short int *Frame::get_memory(const char *error)
+};
+
+struct XRGB8888_Pixel
 {
- unsigned short int *target;
- target=NULL;
- try
+ typedef unsigned int pixel;
+ static pixel convert(const unsigned short int source)
  {
-  target=new unsigned short int[pixels];
+  unsigned int red,green,blue;
+  red=(source>>11)&0x1F;
+  green=(source>>5)&0x3F;
+  blue=source&0x1F;
+  return (((red<<3)|(red>>2))<<16)|(((green<<2)|(green>>4))<<8)|((blue<<3)|(blue>>2));
  }
- catch (...)
+
+};
+
+struct XBGR8888_Pixel
+{
+ typedef unsigned int pixel;
+ static pixel convert(const unsigned short int source)
  {
-  Halt(error);
+  unsigned int red,green,blue;
+  red=(source>>11)&0x1F;
+  green=(source>>5)&0x3F;
+  blue=source&0x1F;
+  return (((blue<<3)|(blue>>2))<<16)|(((green<<2)|(green>>4))<<8)|((red<<3)|(red>>2));
  }
- return target;
-}
 
-void Frame::clear_buffer(unsigned short int *target)
+};
+
+template<typename FORMAT>
+void transfer_span(unsigned char *target,const unsigned short int *source,const size_t amount)
 {
  size_t index;
- for (index=0;index<pixels;++index)
+ typename FORMAT::pixel *output;
+ output=reinterpret_cast<typename FORMAT::pixel*>(target);
+ for (index=0;index<amount;++index)
  {
-  target[index]=0;
+  output[index]=FORMAT::convert(source[index]);
  }
 
 }
 
-unsigned short int *Frame::create_buffer(const char *error)
+template<>
+void transfer_span<RGB565_Pixel>(unsigned char *target,const unsigned short int *source,const size_t amount)
 {
- unsigned short int *target;
- target=NULL;
- this->calculate_buffer_length();
- target=this->get_memory(error);
- this->clear_buffer(target);
- return target;
+ memmove(target,source,amount*sizeof(unsigned short int));
 }
 
-size_t Frame::get_offset(const unsigned long int x,const unsigned long int y,const unsigned long int target_width)
+template<typename FORMAT>
+void scale_span(unsigned char *target,const unsigned short int *source,const size_t *table,const size_t amount)
 {
- return static_cast<size_t>(x)+static_cast<size_t>(y)*static_cast<size_t>(target_width);
-}
+ size_t index;
+ typename FORMAT::pixel *output;
+ output=reinterpret_cast<typename FORMAT::pixel*>(target);
+ for (index=0;index<amount;++index)
+ {
+  output[index]=FORMAT::convert(source[table[index]]);
+ }
 
-size_t Frame::get_offset(const unsigned long int x,const unsigned long int y) const
-{
- return static_cast<size_t>(x)+static_cast<size_t>(y)*static_cast<size_t>(frame_width);
 }
 
-void Frame::set_size(const unsigned long int surface_width,const unsigned long int surface_height)
+template<>
+void scale_span<RGB565_Pixel>(unsigned char *target,const unsigned short int *source,const size_t *table,const size_t amount)
 {
- frame_width=surface_width;
- frame_height=surface_height;
-}
+ size_t index;
+ unsigned short int *output;
+ output=reinterpret_cast<unsigned short int*>(target);
+ for (index=0;index<amount;++index)
+ {
+  output[index]=source[table[index]];
+ }
 
-void Frame::create_buffers()
-{
- buffer=this->create_buffer("Can't allocate memory for render buffer");
- shadow=this->create_buffer("Can't allocate memory for shadow buffer");
 }
 
-size_t Frame::get_length() const
+template<unsigned long int FACTOR>
+void scale_row(unsigned short int *target,const unsigned short int *source,const size_t amount);
+
+template<>
+void scale_row<2>(unsigned short int *target,const unsigned short int *source,const size_t amount)
 {
- return length;
+ size_t index;
+ for (index=0;index<amount;++index)
+ {
+  target[0]=source[index];
+  target[1]=source[index];
+  target+=2;
+ }
+
 }
 
-unsigned short int *Frame::get_buffer()
+template<>
+void scale_row<3>(unsigned short int *target,const unsigned short int *source,const size_t amount)
 {
- return buffer;
+ size_t index;
+ for (index=0;index<amount;++index)
+ {
+  target[0]=source[index];
+  target[1]=source[index];
+  target[2]=source[index];
+  target+=3;
+ }
+
 }
 
-size_t Frame::get_pixels() const
+void Halt(const char *message)
 {
- return pixels;
+ puts(message);
+ exit(EXIT_FAILURE);
 }
 
-unsigned long int Frame::get_frame_width() const
+double get_time()
 {
- return frame_width;
+ timeval current;
+ gettimeofday(&current,NULL);
+ return static_cast<double>(current.tv_sec)+static_cast<double>(current.tv_usec)/1000000.0;
 }
 
-unsigned long int Frame::get_frame_height() const
+const char *get_device(const char *variable,const char *name)
 {
- return frame_height;
+ const char *target;
+ target=getenv(variable);
+ if (target==NULL)
+ {
+  target=name;
+ }
+ else
+ {
+  if (target[0]==0) target=name;
+ }
+ return target;
 }
 
-bool Frame::draw_pixel(const unsigned long int x,const unsigned long int y,const unsigned short int red,const unsigned short int green,const unsigned short int blue)
+bool check_file(const int target)
 {
+ struct stat information;
  bool result;
- size_t offset;
  result=false;
- offset=static_cast<size_t>(x)+static_cast<size_t>(y)*static_cast<size_t>(frame_width);
- if (offset<pixels)
+ if (fstat(target,&information)==0)
  {
-  buffer[offset]=(blue >> 3) +((green >> 2) << 5)+((red >> 3) << 11); // This code bases on code from SVGALib
-  result=true;
+  result=S_ISREG(information.st_mode);
  }
  return result;
 }
 
-void Frame::clear_screen()
+unsigned short int pack_pixel(const unsigned short int red,const unsigned short int green,const unsigned short int blue)
 {
- this->clear_buffer(buffer);
+ return (blue >> 3) +((green >> 2) << 5)+((red >> 3) << 11); // This code bases on code from SVGALib
 }
 
-void Frame::save()
+unsigned short int blend_pixel(const unsigned short int target,const unsigned short int source,const unsigned int level)
 {
- size_t index;
- for (index=0;index<pixels;++index)
- {
-  shadow[index]=buffer[index];
- }
-
+ unsigned int background,foreground,result;
+ background=(target|(target<<16))&BLEND_MASK;
+ foreground=(source|(source<<16))&BLEND_MASK;
+ result=((((foreground-background)*level)>>5)+background)&BLEND_MASK;
+ return static_cast<unsigned short int>(result|(result>>16));
 }
 
-void Frame::restore()
+Dirty_Regions::Dirty_Regions()
 {
- size_t index;
- for (index=0;index<pixels;++index)
+ regions=NULL;
+ amount=0;
+ last=0;
+ full=true;
+ try
+ {
+  regions=new Dirty_Region[DIRTY_LIMIT];
+ }
+ catch (...)
  {
-  buffer[index]=shadow[index];
+  Halt("Can't allocate memory for dirty region list");
  }
 
 }
 
-void Frame::restore(const unsigned long int x,const unsigned long int y,const unsigned long int width,const unsigned long int height)
+Dirty_Regions::~Dirty_Regions()
 {
- unsigned long int target_x,target_y,stop_x,stop_y;
- size_t position;
- stop_x=x+width;
- stop_y=y+height;
- if ((x<frame_width)&&(y<frame_height))
+ if (regions!=NULL)
  {
-  if ((stop_x<=frame_width)&&(stop_y<=frame_height))
-  {
-   for (target_x=x;target_x<stop_x;++target_x)
-   {
-    for (target_y=y;target_y<stop_y;++target_y)
-    {
-     position=this->get_offset(target_x,target_y);
-     buffer[position]=shadow[position];
-    }
-
-   }
-
-  }
-
+  delete[] regions;
+  regions=NULL;
  }
 
 }
 
-Plane::Plane()
+bool Dirty_Regions::check_touch(const Dirty_Region &target,const unsigned long int left,const unsigned long int top,const unsigned long int right,const unsigned long int bottom) const
 {
- target=NULL;
- plane=NULL;
- target_width=0;
- target_height=0;
- x_ratio=0;
- y_ratio=0;
+ return (left<=target.right)&&(right>=target.left)&&(top<=target.bottom)&&(bottom>=target.top);
 }
 
-Plane::~Plane()
+unsigned long int Dirty_Regions::get_growth(const Dirty_Region &target,const unsigned long int left,const unsigned long int top,const unsigned long int right,const unsigned long int bottom) const
 {
-
+ unsigned long int union_left,union_top,union_right,union_bottom;
+ union_left=target.left;
+ union_top=target.top;
+ union_right=target.right;
+ union_bottom=target.bottom;
+ if (left<union_left) union_left=left;
+ if (top<union_top) union_top=top;
+ if (right>union_right) union_right=right;
+ if (bottom>union_bottom) union_bottom=bottom;
+ return (union_right-union_left)*(union_bottom-union_top)-(target.right-target.left)*(target.bottom-target.top);
 }
 
-void Plane::create_plane(const unsigned long int width,const unsigned long int height,const unsigned long int surface_width,const unsigned long int surface_height,unsigned short int *surface_buffer)
+void Dirty_Regions::merge_region(const size_t index,const unsigned long int left,const unsigned long int top,const unsigned long int right,const unsigned long int bottom)
 {
- this->set_size(width,height);
- this->create_buffers();
- plane=this->get_buffer();
- target=surface_buffer;
- target_width=surface_width;
- target_height=surface_height;
- x_ratio=static_cast<float>(width)/static_cast<float>(surface_width);
- y_ratio=static_cast<float>(height)/static_cast<float>(surface_height);
+ if (left<regions[index].left) regions[index].left=left;
+ if (top<regions[index].top) regions[index].top=top;
+ if (right>regions[index].right) regions[index].right=right;
+ if (bottom>regions[index].bottom) regions[index].bottom=bottom;
+ last=index;
 }
 
-void Plane::transfer()
+void Dirty_Regions::add_region(const unsigned long int left,const unsigned long int top,const unsigned long int right,const unsigned long int bottom)
 {
- unsigned long int x,y,width,steps;
- size_t index,location,position;
- width=this->get_frame_width();
- x=0;
- y=0;
- steps=target_width*target_height;
- for (index=0;index<steps;++index)
+ size_t index,target;
+ unsigned long int growth,minimum;
+ if ((full==true)||(left>=right)||(top>=bottom)) return;
+ if (amount>0)
  {
-  location=this->get_offset(x,y,target_width);
-  position=this->get_offset((x_ratio*static_cast<float>(x)),(y_ratio*static_cast<float>(y)),width);
-  target[location]=plane[position];
-  ++x;
-  if (x==target_width)
+  if (this->check_touch(regions[last],left,top,right,bottom)==true)
   {
-   x=0;
-   ++y;
+   this->merge_region(last,left,top,right,bottom);
+   return;
+  }
+
+ }
+ for (index=0;index<amount;++index)
+ {
+  if (this->check_touch(regions[index],left,top,right,bottom)==true)
+  {
+   this->merge_region(index,left,top,right,bottom);
+   return;
   }
 
  }
+ if (amount<DIRTY_LIMIT)
+ {
+  regions[amount].left=left;
+  regions[amount].top=top;
+  regions[amount].right=right;
+  regions[amount].bottom=bottom;
+  last=amount;
+  ++amount;
+ }
+ else
+ {
+  target=0;
+  minimum=this->get_growth(regions[0],left,top,right,bottom);
+  for (index=1;index<amount;++index)
+  {
+   growth=this->get_growth(regions[index],left,top,right,bottom);
+   if (growth<minimum)
+   {
+    minimum=growth;
+    target=index;
+   }
 
-}
+  }
+  this->merge_region(target,left,top,right,bottom);
+ }
 
-Plane* Plane::get_handle()
-{
- return this;
 }
 
-Timer::Timer()
+void Dirty_Regions::add_regions(const Dirty_Regions &target)
 {
- interval=0;
- start=time(NULL);
-}
+ size_t index;
+ if (target.check_full()==true)
+ {
+  this->set_full();
+ }
+ else
+ {
+  for (index=0;index<target.get_amount();++index)
+  {
+   this->add_region(target.get_region(index).left,target.get_region(index).top,target.get_region(index).right,target.get_region(index).bottom);
+  }
 
-Timer::~Timer()
-{
+ }
 
 }
 
-void Timer::set_timer(const double seconds)
+void Dirty_Regions::set_full()
 {
- interval=seconds;
- start=time(NULL);
+ full=true;
+ amount=0;
+ last=0;
 }
 
-bool Timer::check_timer()
+void Dirty_Regions::clear()
 {
- bool result;
- result=false;
- if (difftime(time(NULL),start)>=interval)
- {
-  result=true;
-  start=time(NULL);
- }
- return result;
+ full=false;
+ amount=0;
+ last=0;
 }
 
-FPS::FPS()
+bool Dirty_Regions::check_full() const
 {
- start=time(NULL);
- current=0;
- fps=0;
+ return full;
 }
 
-FPS::~FPS()
+size_t Dirty_Regions::get_amount() const
 {
-
+ return amount;
 }
 
-void FPS::update_counter()
+const Dirty_Region &Dirty_Regions::get_region(const size_t index) const
 {
- ++current;
- if (difftime(time(NULL),start)>=1)
- {
-  fps=current;
-  current=0;
-  start=time(NULL);
- }
+ return regions[index];
+}
 
+Opaque_Runs::Opaque_Runs()
+{
+ runs=NULL;
+ rows=NULL;
+ amount=0;
+ row_amount=0;
+ row=0;
 }
 
-unsigned long int FPS::get_fps() const
+Opaque_Runs::~Opaque_Runs()
 {
- return fps;
+ this->destroy_runs();
 }
 
-Render::Render()
+void Opaque_Runs::destroy_runs()
 {
- start=0;
- device=open("/dev/fb0",O_RDWR);
- if (device==-1)
+ if (runs!=NULL)
+ {
+  delete[] runs;
+  runs=NULL;
+ }
+ if (rows!=NULL)
  {
-  Halt("Can't get access to frame buffer");
+  delete[] rows;
+  rows=NULL;
  }
- memset(&setting,0,sizeof(FBIOGET_VSCREENINFO));
- memset(&configuration,0,sizeof(FBIOGET_FSCREENINFO));
+ amount=0;
+ row_amount=0;
+ row=0;
 }
 
-Render::~Render()
+void Opaque_Runs::copy_runs(const Opaque_Runs &target)
 {
- if (device!=-1) close(device);
+ this->create_runs(target.row_amount,target.amount);
+ memmove(runs,target.runs,target.amount*sizeof(Opaque_Run));
+ memmove(rows,target.rows,(target.row_amount+1)*sizeof(size_t));
+ amount=target.amount;
+ row=target.row;
 }
 
-void Render::read_base_configuration()
+unsigned char Opaque_Runs::classify(const unsigned short int *source,const unsigned char *alpha,const unsigned long int x,const unsigned short int key,const bool keyed) const
 {
- if (ioctl(device,FBIOGET_VSCREENINFO,&setting)==-1)
+ unsigned char result;
+ result=1;
+ if ((keyed==true)&&(source[x]==key))
  {
-  Halt("Can't read framebuffer setting");
+  result=0;
  }
+ else
+ {
+  if (alpha!=NULL)
+  {
+   switch (alpha[x])
+   {
+    case 0:
+    result=0;
+    break;
+    case UCHAR_MAX:
+    result=1;
+    break;
+    default:
+    result=2;
+    break;
+   }
+
+  }
 
+ }
+ return result;
 }
 
-void Render::read_advanced_configuration()
+size_t Opaque_Runs::count_runs(const unsigned short int *source,const unsigned char *alpha,const unsigned long int width,const unsigned short int key,const bool keyed) const
 {
- if (ioctl(device,FBIOGET_FSCREENINFO,&configuration)==-1)
+ unsigned long int x;
+ unsigned char current,previous;
+ size_t result;
+ result=0;
+ previous=0;
+ for (x=0;x<width;++x)
  {
-  Halt("Can't read framebuffer setting");
+  current=this->classify(source,alpha,x,key,keyed);
+  if ((current!=0)&&(current!=previous)) ++result;
+  previous=current;
  }
-
+ return result;
 }
 
-void Render::read_configuration()
+void Opaque_Runs::create_runs(const size_t rows_amount,const size_t runs_amount)
 {
- this->read_base_configuration();
- this->read_advanced_configuration();
+ this->destroy_runs();
+ try
+ {
+  runs=new Opaque_Run[runs_amount+1];
+  rows=new size_t[rows_amount+1];
+ }
+ catch (...)
+ {
+  Halt("Can't allocate memory for opaque run list");
+ }
+ row_amount=rows_amount;
+ rows[0]=0;
 }
 
-void Render::get_start_offset()
+void Opaque_Runs::add_row(const unsigned short int *source,const unsigned char *alpha,const unsigned long int width,const unsigned short int key,const bool keyed)
 {
- start=setting.xoffset*(setting.bits_per_pixel/CHAR_BIT)+setting.yoffset*configuration.line_length;
-}
-
-void Render::prepare_render()
-{
- this->read_configuration();
- this->get_start_offset();
-}
+ unsigned long int x;
+ unsigned char current;
+ x=0;
+ while (x<width)
+ {
+  current=this->classify(source,alpha,x,key,keyed);
+  if (current==0)
+  {
+   ++x;
+  }
+  else
+  {
+   runs[amount].offset=x;
+   runs[amount].translucent=current==2;
+   while ((x<width)&&(this->classify(source,alpha,x,key,keyed)==current))
+   {
+    ++x;
+   }
+   runs[amount].length=x-runs[amount].offset;
+   ++amount;
+  }
 
-void Render::refresh()
-{
- lseek(device,start,SEEK_SET);
- write(device,this->get_buffer(),this->get_length());
+ }
+ ++row;
+ rows[row]=amount;
 }
 
-unsigned long int Render::get_width() const
+size_t Opaque_Runs::get_first(const size_t target) const
 {
- return setting.xres;
+ return rows[target];
 }
 
-unsigned long int Render::get_height() const
+size_t Opaque_Runs::get_last(const size_t target) const
 {
- return setting.yres;
+ return rows[target+1];
 }
 
-unsigned long int Render::get_color() const
+const Opaque_Run &Opaque_Runs::get_run(const size_t index) const
 {
- return setting.bits_per_pixel;
+ return runs[index];
 }
 
-Screen::Screen()
+Collision_Mask::Collision_Mask()
 {
-
+ mask=NULL;
+ pitch=0;
+ row_amount=0;
+ mask_width=0;
 }
 
-Screen::~Screen()
+Collision_Mask::~Collision_Mask()
 {
-
+ this->destroy_mask();
 }
 
-void Screen::initialize()
+void Collision_Mask::set_span(unsigned int *target,const unsigned long int offset,const unsigned long int length)
 {
- this->prepare_render();
- this->set_size(this->get_width(),this->get_height());
- this->create_buffers();
-}
+ unsigned long int x;
+ for (x=offset;x<offset+length;++x)
+ {
+  target[x/MASK_BITS]|=1U<<(MASK_BITS-1-x%MASK_BITS);
+ }
 
-void Screen::update()
-{
- this->refresh();
- this->update_counter();
 }
 
-Screen* Screen::get_handle()
+unsigned int Collision_Mask::get_word(const unsigned int *target,const unsigned long int offset)
 {
- return this;
+ unsigned long int shift;
+ unsigned int word;
+ shift=offset%MASK_BITS;
+ word=target[offset/MASK_BITS];
+ if (shift>0) word=(word<<shift)|(target[offset/MASK_BITS+1]>>(MASK_BITS-shift));
+ return word;
 }
 
-Gamepad::Gamepad()
+void Collision_Mask::destroy_mask()
 {
- current=NULL;
- preversion=NULL;
- device=-1;
- length=sizeof(input_event);
- memset(&input,0,length);
+ if (mask!=NULL)
+ {
+  delete[] mask;
+  mask=NULL;
+ }
+ pitch=0;
+ row_amount=0;
+ mask_width=0;
 }
 
-Gamepad::~Gamepad()
+void Collision_Mask::copy_mask(const Collision_Mask &target)
 {
- if (device!=-1) close(device);
- if (current!=NULL) delete[] current;
- if (preversion!=NULL) delete[] preversion;
+ this->create_mask(target.row_amount,target.mask_width);
+ memmove(mask,target.mask,2*row_amount*pitch*sizeof(unsigned int));
 }
 
-unsigned char *Gamepad::get_memory(const char *message)
+void Collision_Mask::create_mask(const size_t rows_amount,const unsigned long int width)
 {
- unsigned char *buffer;
- buffer=NULL;
+ this->destroy_mask();
+ pitch=static_cast<size_t>(width/MASK_BITS)+2;
  try
  {
-  buffer=new unsigned char[BUTTON_AMOUNT];
+  mask=new unsigned int[2*rows_amount*pitch];
  }
  catch (...)
  {
-  Halt(message);
+  Halt("Can't allocate memory for collision mask");
  }
- return buffer;
+ memset(mask,0,2*rows_amount*pitch*sizeof(unsigned int));
+ row_amount=rows_amount;
+ mask_width=width;
 }
 
-void Gamepad::clear_buffer(unsigned char *target)
+void Collision_Mask::add_row(const size_t target,const Opaque_Runs &runs,const size_t row)
 {
- size_t index;
- for (index=0;index<BUTTON_AMOUNT;++index)
+ size_t index,last;
+ unsigned int *normal;
+ unsigned int *mirror;
+ normal=mask+target*pitch;
+ mirror=mask+(row_amount+target)*pitch;
+ last=runs.get_last(row);
+ for (index=runs.get_first(row);index<last;++index)
  {
-  target[index]=GAMEPAD_RELEASE;
+  this->set_span(normal,runs.get_run(index).offset,runs.get_run(index).length);
+  this->set_span(mirror,mask_width-runs.get_run(index).offset-runs.get_run(index).length,runs.get_run(index).length);
  }
 
 }
 
-unsigned char *Gamepad::create_buffer(const char *message)
+const unsigned int *Collision_Mask::get_row(const size_t target,const bool mirror) const
 {
- unsigned char *buffer;
- buffer=this->get_memory(message);
- this->clear_buffer(buffer);
- return buffer;
+ const unsigned int *row;
+ row=mask+target*pitch;
+ if (mirror==true) row+=row_amount*pitch;
+ return row;
 }
 
-void Gamepad::create_buffers()
+bool Collision_Mask::check_rows(const unsigned int *first,const unsigned long int first_offset,const unsigned int *second,const unsigned long int second_offset,const unsigned long int length)
 {
- current=this->create_buffer("Can't allocate memory for primary input buffer");
- preversion=this->create_buffer("Can't allocate memory for secondary input buffer");
+ unsigned long int x;
+ bool result;
+ result=false;
+ for (x=0;(x<length)&&(result==false);x+=MASK_BITS)
+ {
+  result=(Collision_Mask::get_word(first,first_offset+x)&Collision_Mask::get_word(second,second_offset+x))!=0;
+ }
+ return result;
 }
 
-void Gamepad::open_device()
+Frame::Frame()
 {
- device=open("/dev/event0",O_RDONLY|O_NONBLOCK|O_NOCTTY);
- if (device==-1)
+ tracking=false;
+ frame_width=0;
+ frame_height=0;
+ pixels=0;
+ length=0;
+ buffer=NULL;
+ shadow=NULL;
+ backup=NULL;
+ saves=0;
+}
+
+Frame::~Frame()
+{
+ if (buffer!=NULL)
  {
-  Halt("Can't get access to gamepad");
+  delete[] buffer;
+  buffer=NULL;
+ }
+ if (shadow!=NULL)
+ {
+  delete[] shadow;
+  shadow=NULL;
  }
 
 }
 
-unsigned char Gamepad::get_state() const
+void Frame::calculate_buffer_length()
 {
- unsigned char state;
- state=GAMEPAD_RELEASE;
- if (input.value!=GAMEPAD_RELEASE)
- {
-  state=GAMEPAD_PRESS;
- }
- return state;
+ pixels=static_cast<size_t>(frame_width)*static_cast<size_t>(frame_height);
+ length=pixels*sizeof(unsigned short int);
 }
 
-GAMEPAD_BUTTONS Gamepad::get_button() const
+unsigned short int *Frame::get_memory(const char *error)
 {
- GAMEPAD_BUTTONS button;
- button=BUTTON_UP;
- switch (input.code)
+ unsigned short int *target;
+ target=NULL;
+ try
  {
-  case KEY_UP:
-  button=BUTTON_UP;
-  break;
-  case KEY_DOWN:
-  button=BUTTON_DOWN;
-  break;
-  case KEY_LEFT:
-  button=BUTTON_LEFT;
-  break;
-  case KEY_RIGHT:
-  button=BUTTON_RIGHT;
-  break;
-  case KEY_LEFTCTRL:
-  button=BUTTON_A;
-  break;
-  case KEY_LEFTALT:
-  button=BUTTON_B;
-  break;
-  case KEY_SPACE:
-  button=BUTTON_X;
-  break;
-  case KEY_LEFTSHIFT:
-  button=BUTTON_Y;
-  break;
-  case KEY_BACKSPACE:
-  button=BUTTON_R;
-  break;
-  case KEY_TAB:
-  button=BUTTON_L;
-  break;
-  case KEY_ENTER:
-  button=BUTTON_START;
-  break;
-  case KEY_ESC:
-  button=BUTTON_MENU;
-  break;
-  case KEY_2:
-  button=BUTTON_C;
-  break;
-  case KEY_1:
-  button=BUTTON_Z;
-  break;
-  case KEY_POWER:
-  button=BUTTON_POWER;
-  break;
-  case KEY_PAUSE:
-  button=BUTTON_HOLD;
-  break;
+  target=new unsigned short int[pixels];
  }
- return button;
+ catch (...)
+ {
+  Halt(error);
+ }
+ return target;
 }
 
-bool Gamepad::check_state(const GAMEPAD_BUTTONS button,const unsigned char state)
+void Frame::clear_buffer(unsigned short int *target)
 {
- bool result;
- result=false;
- if (current[button]==state)
- {
-  if (preversion[button]!=state) result=true;
- }
- preversion[button]=current[button];
- return result;
+ memset(target,0,length);
 }
 
-void Gamepad::initialize()
+unsigned short int *Frame::create_buffer(const char *error)
 {
- this->open_device();
- this->create_buffers();
+ unsigned short int *target;
+ target=NULL;
+ this->calculate_buffer_length();
+ target=this->get_memory(error);
+ this->clear_buffer(target);
+ return target;
 }
 
-void Gamepad::update()
+void Frame::copy_span(unsigned short int *target,const unsigned short int *source,const unsigned long int amount,const bool reverse)
 {
- while (read(device,&input,length)>0)
+ unsigned long int index;
+ if (reverse==true)
  {
-  if (input.type==EV_KEY)
+  for (index=0;index<amount;++index)
   {
-   current[this->get_button()]=this->get_state();
+   target[index]=*source;
+   --source;
   }
 
  }
+ else
+ {
+  memmove(target,source,static_cast<size_t>(amount)*sizeof(unsigned short int));
+ }
 
 }
 
-bool Gamepad::check_hold(const GAMEPAD_BUTTONS button)
+void Frame::blend_span(unsigned short int *target,const unsigned short int *source,const unsigned char *alpha,const unsigned long int amount,const bool reverse,const unsigned char opacity)
 {
- preversion[button]=current[button];
- return current[button]!=GAMEPAD_RELEASE;
+ unsigned long int index;
+ unsigned int level;
+ level=(static_cast<unsigned int>(opacity)+4)>>3;
+ for (index=0;index<amount;++index)
+ {
+  if (alpha!=NULL)
+  {
+   level=(((static_cast<unsigned int>(*alpha)*(static_cast<unsigned int>(opacity)+1))>>8)+4)>>3;
+   if (reverse==true)
+   {
+    --alpha;
+   }
+   else
+   {
+    ++alpha;
+   }
+
+  }
+  target[index]=blend_pixel(target[index],*source,level);
+  if (reverse==true)
+  {
+   --source;
+  }
+  else
+  {
+   ++source;
+  }
+
+ }
+
 }
 
-bool Gamepad::check_press(const GAMEPAD_BUTTONS button)
+size_t Frame::get_offset(const unsigned long int x,const unsigned long int y,const unsigned long int target_width)
 {
- return this->check_state(button,GAMEPAD_PRESS);
+ return static_cast<size_t>(x)+static_cast<size_t>(y)*static_cast<size_t>(target_width);
 }
 
-bool Gamepad::check_release(const GAMEPAD_BUTTONS button)
+size_t Frame::get_offset(const unsigned long int x,const unsigned long int y) const
 {
- return this->check_state(button,GAMEPAD_RELEASE);
+ return static_cast<size_t>(x)+static_cast<size_t>(y)*static_cast<size_t>(frame_width);
 }
 
-Memory::Memory()
+void Frame::set_size(const unsigned long int surface_width,const unsigned long int surface_height)
 {
- memset(&information,0,sizeof(struct sysinfo));
+ frame_width=surface_width;
+ frame_height=surface_height;
 }
 
-Memory::~Memory()
+void Frame::create_buffers()
+{
+ buffer=this->create_buffer("Can't allocate memory for render buffer");
+ shadow=this->create_buffer("Can't allocate memory for shadow buffer");
+ backup=shadow;
+ dirty.set_full();
+}
+
+size_t Frame::get_length() const
 {
+ return length;
+}
 
+const Dirty_Regions &Frame::get_dirty() const
+{
+ return dirty;
 }
 
-void Memory::read_system_information()
+void Frame::clear_dirty()
 {
- if (sysinfo(&information)==-1)
+ if (tracking==true)
  {
-  Halt("Can't read system information");
+  dirty.clear();
+ }
+ else
+ {
+  dirty.set_full();
  }
 
 }
 
-unsigned long int Memory::get_total_memory()
+unsigned short int *Frame::get_buffer()
 {
- this->read_system_information();
- return information.totalram*information.mem_unit;
+ return buffer;
 }
 
-unsigned long int Memory::get_free_memory()
+size_t Frame::get_pixels() const
 {
- this->read_system_information();
- return information.freeram*information.mem_unit;
+ return pixels;
 }
 
-Sound::Sound()
+unsigned long int Frame::get_frame_width() const
 {
- internal=NULL;
- buffer_length=0;
- stream=0;
+ return frame_width;
 }
 
-Sound::~Sound()
+unsigned long int Frame::get_frame_height() const
 {
- OSS_BACKEND::run_stream=false;
+ return frame_height;
 }
 
-void Sound::open_device()
+bool Frame::draw_pixel(const unsigned long int x,const unsigned long int y,const unsigned short int red,const unsigned short int green,const unsigned short int blue)
 {
- OSS_BACKEND::sound_device=open("/dev/dsp",O_WRONLY,S_IRWXU|S_IRWXG|S_IRWXO);
- if (OSS_BACKEND::sound_device==-1)
- {
-  Halt("Can't get access to sound card");
- }
-
+ return this->draw_pixel(x,y,pack_pixel(red,green,blue));
 }
 
-void Sound::set_format()
+bool Frame::draw_pixel(const unsigned long int x,const unsigned long int y,const unsigned short int color)
 {
- int format;
- format=AFMT_S16_LE;
- if (ioctl(OSS_BACKEND::sound_device,SNDCTL_DSP_SETFMT,&format)==-1)
+ bool result;
+ size_t offset;
+ result=false;
+ offset=static_cast<size_t>(x)+static_cast<size_t>(y)*static_cast<size_t>(frame_width);
+ if (offset<pixels)
  {
-  Halt("Can't set sound format");
- }
+  buffer[offset]=color;
+  if (tracking==true)
+  {
+   if (x<frame_width)
+   {
+    dirty.add_region(x,y,x+1,y+1);
+   }
+   else
+   {
+    dirty.add_region(offset%frame_width,offset/frame_width,offset%frame_width+1,offset/frame_width+1);
+   }
 
+  }
+  result=true;
+ }
+ return result;
 }
 
-void Sound::set_channels()
+void Frame::draw_image(const unsigned long int x,const unsigned long int y,const unsigned long int width,const unsigned long int height,const unsigned short int *source,const unsigned long int stride,const bool horizontal,const bool vertical)
 {
- int channels;
- channels=SOUND_CHANNELS;
- if (ioctl(OSS_BACKEND::sound_device,SNDCTL_DSP_CHANNELS,&channels)==-1)
+ unsigned long int line,row,visible_width,visible_height;
+ const unsigned short int *data;
+ unsigned short int *target;
+ if ((x<frame_width)&&(y<frame_height))
  {
-  Halt("Can't set number of audio channels");
+  visible_width=width;
+  visible_height=height;
+  if (width>frame_width-x) visible_width=frame_width-x;
+  if (height>frame_height-y) visible_height=frame_height-y;
+  this->invalidate(x,y,visible_width,visible_height);
+  target=buffer+this->get_offset(x,y);
+  for (line=0;line<visible_height;++line)
+  {
+   row=line;
+   if (vertical==true) row=height-line-1;
+   data=source+static_cast<size_t>(row)*static_cast<size_t>(stride);
+   if (horizontal==true) data+=width-1;
+   this->copy_span(target,data,visible_width,horizontal);
+   target+=frame_width;
+  }
+
  }
 
 }
 
-void Sound::set_rate(const int rate)
+void Frame::draw_runs(const unsigned long int x,const unsigned long int y,const unsigned long int width,const unsigned long int height,const unsigned short int *source,const unsigned long int stride,const Opaque_Runs &runs,const size_t row,const unsigned long int origin,const bool horizontal,const bool vertical)
 {
- if (ioctl(OSS_BACKEND::sound_device,SNDCTL_DSP_SPEED,&rate)==-1)
+ unsigned long int line,current,visible_width,visible_height,left,first,length;
+ size_t index,last;
+ const Opaque_Run *run;
+ const unsigned short int *data;
+ unsigned short int *target;
+ if ((x<frame_width)&&(y<frame_height))
  {
-  Halt("Can't set sample rate");
+  visible_width=width;
+  visible_height=height;
+  if (width>frame_width-x) visible_width=frame_width-x;
+  if (height>frame_height-y) visible_height=frame_height-y;
+  this->invalidate(x,y,visible_width,visible_height);
+  target=buffer+this->get_offset(x,y);
+  for (line=0;line<visible_height;++line)
+  {
+   current=line;
+   if (vertical==true) current=height-line-1;
+   data=source+static_cast<size_t>(current)*static_cast<size_t>(stride);
+   last=runs.get_last(row+current);
+   for (index=runs.get_first(row+current);index<last;++index)
+   {
+    run=&runs.get_run(index);
+    left=run->offset-origin;
+    first=left;
+    if (horizontal==true)
+    {
+     left=width-first-run->length;
+     first+=run->length-1;
+    }
+    if (left<visible_width)
+    {
+     length=run->length;
+     if (length>visible_width-left) length=visible_width-left;
+     this->copy_span(target+left,data+first,length,horizontal);
+    }
+
+   }
+   target+=frame_width;
+  }
+
  }
 
 }
 
-void Sound::get_buffer_length()
+void Frame::draw_scrolled(const unsigned long int width,const unsigned long int height,const unsigned short int *source,const unsigned long int stride,const unsigned long int scroll_x,const unsigned long int scroll_y,const bool horizontal_wrap,const bool vertical_wrap,const bool horizontal,const bool vertical)
 {
- audio_buf_info configuration;
- memset(&configuration,0,sizeof(audio_buf_info));
- if (ioctl(OSS_BACKEND::sound_device,SNDCTL_DSP_GETOSPACE,&configuration)==-1)
+ unsigned long int line,column,current,first,length,visible_width,visible_height;
+ const unsigned short int *data;
+ unsigned short int *target;
+ if ((width>0)&&(height>0))
  {
-  Halt("Can't read configuration of sound buffer");
+  visible_width=frame_width;
+  visible_height=frame_height;
+  if (horizontal_wrap==false)
+  {
+   visible_width=0;
+   if (scroll_x<width) visible_width=width-scroll_x;
+   if (visible_width>frame_width) visible_width=frame_width;
+  }
+  if (vertical_wrap==false)
+  {
+   visible_height=0;
+   if (scroll_y<height) visible_height=height-scroll_y;
+   if (visible_height>frame_height) visible_height=frame_height;
+  }
+  if ((visible_width>0)&&(visible_height>0))
+  {
+   this->invalidate(0,0,visible_width,visible_height);
+   target=buffer;
+   current=scroll_y%height;
+   for (line=0;line<visible_height;++line)
+   {
+    data=source+static_cast<size_t>(current)*static_cast<size_t>(stride);
+    if (vertical==true) data=source+static_cast<size_t>(height-current-1)*static_cast<size_t>(stride);
+    first=scroll_x%width;
+    for (column=0;column<visible_width;column+=length)
+    {
+     length=width-first;
+     if (length>visible_width-column) length=visible_width-column;
+     if (horizontal==true)
+     {
+      this->copy_span(target+column,data+width-first-1,length,true);
+     }
+     else
+     {
+      this->copy_span(target+column,data+first,length,false);
+     }
+     first=0;
+    }
+    ++current;
+    if (current==height) current=0;
+    target+=frame_width;
+   }
+
+  }
+
  }
- buffer_length=static_cast<size_t>(configuration.fragstotal)*static_cast<size_t>(configuration.fragsize);
-}
 
-void Sound::configure_sound_card(const int rate)
-{
- this->open_device();
- this->set_format();
- this->set_rate(rate);
- this->set_channels();
- this->get_buffer_length();
 }
 
-void Sound::start_stream()
+void Frame::draw_scrolled_runs(const unsigned long int width,const unsigned long int height,const unsigned short int *source,const unsigned long int stride,const Opaque_Runs &runs,const size_t row,const unsigned long int scroll_x,const unsigned long int scroll_y,const bool horizontal_wrap,const bool vertical_wrap,const bool horizontal,const bool vertical)
 {
- if (pthread_create(&stream,NULL,oss_play_sound,internal)!=0)
+ unsigned long int line,current,first,length,skip,visible_width,visible_height;
+ long int tile,left;
+ size_t index,last,source_row;
+ const Opaque_Run *run;
+ const unsigned short int *data;
+ unsigned short int *target;
+ if ((width>0)&&(height>0))
  {
-  Halt("Can't start sound stream");
+  visible_width=frame_width;
+  visible_height=frame_height;
+  if (horizontal_wrap==false)
+  {
+   visible_width=0;
+   if (scroll_x<width) visible_width=width-scroll_x;
+   if (visible_width>frame_width) visible_width=frame_width;
+  }
+  if (vertical_wrap==false)
+  {
+   visible_height=0;
+   if (scroll_y<height) visible_height=height-scroll_y;
+   if (visible_height>frame_height) visible_height=frame_height;
+  }
+  if ((visible_width>0)&&(visible_height>0))
+  {
+   this->invalidate(0,0,visible_width,visible_height);
+   target=buffer;
+   current=scroll_y%height;
+   for (line=0;line<visible_height;++line)
+   {
+    source_row=static_cast<size_t>(current);
+    if (vertical==true) source_row=static_cast<size_t>(height-current-1);
+    data=source+source_row*static_cast<size_t>(stride);
+    last=runs.get_last(row+source_row);
+    for (tile=-static_cast<long int>(scroll_x%width);(tile<static_cast<long int>(visible_width))&&((horizontal_wrap==true)||(tile<=0));tile+=static_cast<long int>(width))
+    {
+     for (index=runs.get_first(row+source_row);index<last;++index)
+     {
+      run=&runs.get_run(index);
+      first=run->offset;
+      left=tile+static_cast<long int>(run->offset);
+      if (horizontal==true)
+      {
+       first=run->offset+run->length-1;
+       left=tile+static_cast<long int>(width-run->offset-run->length);
+      }
+      length=run->length;
+      if (left<0)
+      {
+       skip=static_cast<unsigned long int>(-left);
+       length=0;
+       if (skip<run->length) length=run->length-skip;
+       if (horizontal==true)
+       {
+        first-=skip;
+       }
+       else
+       {
+        first+=skip;
+       }
+       left=0;
+      }
+      if ((length>0)&&(left<static_cast<long int>(visible_width)))
+      {
+       if (length>visible_width-static_cast<unsigned long int>(left)) length=visible_width-static_cast<unsigned long int>(left);
+       this->copy_span(target+left,data+first,length,horizontal);
+      }
+
+     }
+
+    }
+    ++current;
+    if (current==height) current=0;
+    target+=frame_width;
+   }
+
+  }
+
  }
 
 }
 
-void Sound::create_buffer()
+void Frame::draw_affine(const unsigned long int x,const unsigned long int y,const unsigned long int width,const unsigned long int height,const unsigned short int *source,const unsigned char *alpha,const unsigned long int stride,const double angle,const double scale,const bool keyed,const unsigned short int key,const bool horizontal,const bool vertical)
 {
- internal=static_cast<char*>(calloc(buffer_length,sizeof(char)));
- if (internal==NULL)
+ double sine,cosine,extent_x,extent_y,center_x,center_y,delta_x,delta_y;
+ long int left,top,right,bottom,column,line,u,v,row_u,row_v,step_ux,step_vx,step_uy,step_vy;
+ unsigned long int source_x,source_y;
+ size_t offset;
+ unsigned short int *target;
+ if ((scale>0)&&(width>0)&&(height>0))
  {
-  Halt("Can't allocate memory for sound buffer");
+  sine=sin(angle*PI/180.0);
+  cosine=cos(angle*PI/180.0);
+  extent_x=(fabs(cosine)*static_cast<double>(width)+fabs(sine)*static_cast<double>(height))*scale/2.0;
+  extent_y=(fabs(sine)*static_cast<double>(width)+fabs(cosine)*static_cast<double>(height))*scale/2.0;
+  center_x=static_cast<double>(x)+static_cast<double>(width)/2.0;
+  center_y=static_cast<double>(y)+static_cast<double>(height)/2.0;
+  left=0;
+  top=0;
+  right=static_cast<long int>(frame_width);
+  bottom=static_cast<long int>(frame_height);
+  if (center_x-extent_x>=static_cast<double>(frame_width)) left=right;
+  if (center_y-extent_y>=static_cast<double>(frame_height)) top=bottom;
+  if ((center_x-extent_x>0)&&(left<right)) left=static_cast<long int>(floor(center_x-extent_x));
+  if ((center_y-extent_y>0)&&(top<bottom)) top=static_cast<long int>(floor(center_y-extent_y));
+  if (center_x+extent_x<static_cast<double>(frame_width)) right=static_cast<long int>(ceil(center_x+extent_x));
+  if (center_y+extent_y<static_cast<double>(frame_height)) bottom=static_cast<long int>(ceil(center_y+extent_y));
+  if ((left<right)&&(top<bottom))
+  {
+   this->invalidate(left,top,right-left,bottom-top);
+   step_ux=static_cast<long int>(floor(cosine/scale*AFFINE_ONE));
+   step_vx=static_cast<long int>(floor(-sine/scale*AFFINE_ONE));
+   step_uy=static_cast<long int>(floor(sine/scale*AFFINE_ONE));
+   step_vy=static_cast<long int>(floor(cosine/scale*AFFINE_ONE));
+   delta_x=static_cast<double>(left)+0.5-center_x;
+   delta_y=static_cast<double>(top)+0.5-center_y;
+   row_u=static_cast<long int>(floor(((cosine*delta_x+sine*delta_y)/scale+static_cast<double>(width)/2.0)*AFFINE_ONE));
+   row_v=static_cast<long int>(floor(((cosine*delta_y-sine*delta_x)/scale+static_cast<double>(height)/2.0)*AFFINE_ONE));
+   target=buffer+this->get_offset(left,top);
+   for (line=top;line<bottom;++line)
+   {
+    u=row_u;
+    v=row_v;
+    for (column=0;column<right-left;++column)
+    {
+     if ((u>=0)&&(v>=0))
+     {
+      source_x=static_cast<unsigned long int>(u/AFFINE_ONE);
+      source_y=static_cast<unsigned long int>(v/AFFINE_ONE);
+      if ((source_x<width)&&(source_y<height))
+      {
+       if (horizontal==true) source_x=width-source_x-1;
+       if (vertical==true) source_y=height-source_y-1;
+       offset=static_cast<size_t>(source_y)*static_cast<size_t>(stride)+static_cast<size_t>(source_x);
+       if ((keyed==false)||(source[offset]!=key))
+       {
+        if (alpha==NULL)
+        {
+         target[column]=source[offset];
+        }
+        else
+        {
+         if (alpha[offset]!=0) target[column]=source[offset];
+        }
+
+       }
+
+      }
+
+     }
+     u+=step_ux;
+     v+=step_vx;
+    }
+    row_u+=step_uy;
+    row_v+=step_vy;
+    target+=frame_width;
+   }
+
+  }
+
  }
 
 }
 
-void Sound::initialize(const int rate)
+void Frame::draw_blended_runs(const unsigned long int x,const unsigned long int y,const unsigned long int width,const unsigned long int height,const unsigned short int *source,const unsigned char *alpha,const unsigned long int stride,const Opaque_Runs &runs,const size_t row,const unsigned long int origin,const unsigned char opacity,const bool horizontal,const bool vertical)
 {
- this->configure_sound_card(rate);
- this->create_buffer();
- this->start_stream();
-}
+ unsigned long int line,current,visible_width,visible_height,left,first,length;
+ size_t index,last;
+ const Opaque_Run *run;
+ const unsigned short int *data;
+ const unsigned char *level;
+ unsigned short int *target;
+ if ((x<frame_width)&&(y<frame_height))
+ {
+  visible_width=width;
+  visible_height=height;
+  if (width>frame_width-x) visible_width=frame_width-x;
+  if (height>frame_height-y) visible_height=frame_height-y;
+  this->invalidate(x,y,visible_width,visible_height);
+  target=buffer+this->get_offset(x,y);
+  for (line=0;line<visible_height;++line)
+  {
+   current=line;
+   if (vertical==true) current=height-line-1;
+   data=source+static_cast<size_t>(current)*static_cast<size_t>(stride);
+   last=runs.get_last(row+current);
+   for (index=runs.get_first(row+current);index<last;++index)
+   {
+    run=&runs.get_run(index);
+    left=run->offset-origin;
+    first=left;
+    if (horizontal==true)
+    {
+     left=width-first-run->length;
+     first+=run->length-1;
+    }
+    if (left<visible_width)
+    {
+     length=run->length;
+     if (length>visible_width-left) length=visible_width-left;
+     level=NULL;
+     if (run->translucent==true) level=alpha+static_cast<size_t>(current)*static_cast<size_t>(stride)+first;
+     if ((level==NULL)&&(opacity==UCHAR_MAX))
+     {
+      this->copy_span(target+left,data+first,length,horizontal);
+     }
+     else
+     {
+      this->blend_span(target+left,data+first,level,length,horizontal,opacity);
+     }
 
-bool Sound::check_busy()
-{
- return OSS_BACKEND::do_play;
-}
+    }
+
+   }
+   target+=frame_width;
+  }
+
+ }
 
-size_t Sound::get_length() const
-{
- return buffer_length;
 }
 
-size_t Sound::send(char *buffer,const size_t length)
+void Frame::fill_rectangle(const unsigned long int x,const unsigned long int y,const unsigned long int width,const unsigned long int height,const unsigned short int color)
 {
- size_t amount;
- if (OSS_BACKEND::do_play)
- {
-  amount=0;
- }
- else
+ unsigned long int line,column,visible_width,visible_height;
+ unsigned short int *target;
+ if ((x<frame_width)&&(y<frame_height))
  {
-  amount=buffer_length;
-  if (length<buffer_length) amount=length;
-  memmove(internal,buffer,amount);
-  OSS_BACKEND::sound_buffer_length=amount;
-  OSS_BACKEND::do_play=true;
+  visible_width=width;
+  visible_height=height;
+  if (width>frame_width-x) visible_width=frame_width-x;
+  if (height>frame_height-y) visible_height=frame_height-y;
+  this->invalidate(x,y,visible_width,visible_height);
+  target=buffer+this->get_offset(x,y);
+  for (line=0;line<visible_height;++line)
+  {
+   for (column=0;column<visible_width;++column)
+   {
+    target[column]=color;
+   }
+   target+=frame_width;
+  }
+
  }
- return amount;
+
 }
 
-Sound* Sound::get_handle()
+void Frame::clear_screen()
 {
- return this;
+ this->clear_buffer(buffer);
+ dirty.set_full();
 }
 
-Mixer::Mixer()
+void Frame::save()
 {
- device=-1;
- minimum=15;
- maximum=255;
- current=minimum;
+ memmove(shadow,buffer,length);
+ backup=shadow;
+ ++saves;
 }
 
-Mixer::~Mixer()
+void Frame::restore()
 {
- if (device==-1) close(device);
+ memmove(buffer,backup,length);
+ dirty.set_full();
 }
 
-void Mixer::open_device()
+void Frame::restore(const unsigned long int x,const unsigned long int y,const unsigned long int width,const unsigned long int height)
 {
- device=open("/dev/mixer",O_RDWR);
- if (device==-1)
+ unsigned long int target_y,stop_x,stop_y;
+ size_t position,amount;
+ stop_x=x+width;
+ stop_y=y+height;
+ if ((x<frame_width)&&(y<frame_height))
  {
-  Halt("Can't get access to mixer");
+  if ((stop_x<=frame_width)&&(stop_y<=frame_height))
+  {
+   amount=static_cast<size_t>(width)*sizeof(unsigned short int);
+   position=this->get_offset(x,y);
+   for (target_y=y;target_y<stop_y;++target_y)
+   {
+    memmove(buffer+position,backup+position,amount);
+    position+=frame_width;
+   }
+   this->invalidate(x,y,width,height);
+  }
+
  }
 
 }
 
-void Mixer::set_level(const int level)
+void Frame::restore(const unsigned short int *source)
+{
+ memmove(buffer,source,length);
+ backup=source;
+ ++saves;
+ dirty.set_full();
+}
+
+void Frame::detach_shadow(const unsigned short int *source)
 {
- if (ioctl(device,SOUND_MIXER_WRITE_VOLUME,&level)==-1)
+ if (backup==source)
  {
-  Halt("Can't set volume");
+  memmove(shadow,source,length);
+  backup=shadow;
  }
 
 }
 
-int Mixer::correct_level(const int level) const
+unsigned long int Frame::get_saves() const
 {
- int value;
- value=level;
- if (value<minimum) value=minimum;
- if (value>maximum) value=maximum;
- return value;
+ return saves;
 }
 
-void Mixer::set_volume(const int level)
+void Frame::set_tracking(const bool enabled)
 {
- current=(this->correct_level(level)<<8)+this->correct_level(level);
- this->set_level(current);
+ tracking=enabled;
+ dirty.set_full();
 }
 
-void Mixer::turn_on()
+bool Frame::get_tracking() const
 {
- this->set_volume(current);
+ return tracking;
 }
 
-void Mixer::turn_off()
+void Frame::invalidate()
 {
- this->set_level(0);
+ dirty.set_full();
 }
 
-void Mixer::initialize()
+void Frame::invalidate(const unsigned long int x,const unsigned long int y,const unsigned long int width,const unsigned long int height)
 {
- this->open_device();
- this->set_level(current);
-}
+ unsigned long int right,bottom;
+ if (tracking==true)
+ {
+  if ((x<frame_width)&&(y<frame_height))
+  {
+   right=frame_width;
+   bottom=frame_height;
+   if (width<frame_width-x) right=x+width;
+   if (height<frame_height-y) bottom=y+height;
+   dirty.add_region(x,y,right,bottom);
+  }
+
+ }
 
-int Mixer::get_minimum() const
-{
- return minimum;
 }
 
-int Mixer::get_maximum() const
+Plane::Plane()
 {
- return maximum;
+ target=NULL;
+ plane=NULL;
+ target_width=0;
+ target_height=0;
+ factor=0;
+ columns=NULL;
+ rows=NULL;
 }
 
-int Mixer::get_volume() const
+Plane::~Plane()
 {
- return current;
+ this->destroy_tables();
 }
 
-Backlight::Backlight()
+size_t *Plane::create_table(const unsigned long int amount)
 {
- device=NULL;
- minimum=10;
- maximum=90;
- current=minimum;
- memset(buffer,0,4);
+ size_t *table;
+ table=NULL;
+ try
+ {
+  table=new size_t[amount];
+ }
+ catch (...)
+ {
+  Halt("Can't allocate memory for scale table");
+ }
+ return table;
 }
 
-Backlight::~Backlight()
+void Plane::destroy_tables()
 {
+ if (columns!=NULL)
+ {
+  delete[] columns;
+  columns=NULL;
+ }
+ if (rows!=NULL)
+ {
+  delete[] rows;
+  rows=NULL;
+ }
 
 }
 
-void Backlight::open_device(const char *mode)
+void Plane::fill_table(size_t *table,const unsigned long int source_amount,const unsigned long int target_amount,const size_t stride)
 {
- device=fopen("/proc/jz/lcd_backlight",mode);
- if (device==NULL)
+ unsigned long int index,position,remainder;
+ position=0;
+ remainder=0;
+ for (index=0;index<target_amount;++index)
  {
-  Halt("Can't get access to display backlight");
+  table[index]=static_cast<size_t>(position)*stride;
+  remainder+=source_amount;
+  while (remainder>=target_amount)
+  {
+   remainder-=target_amount;
+   ++position;
+  }
+
  }
 
 }
 
-void Backlight::open_read()
+void Plane::get_factor()
 {
- this->open_device("rt");
-}
+ unsigned long int width,height;
+ width=this->get_frame_width();
+ height=this->get_frame_height();
+ factor=0;
+ if ((width>0)&&(height>0))
+ {
+  if ((target_width%width==0)&&(target_height%height==0))
+  {
+   if (target_width/width==target_height/height) factor=target_width/width;
+  }
 
-void Backlight::open_write()
-{
- this->open_device("wt");
-}
+ }
 
-void Backlight::close_device()
-{
- if (device!=NULL) fclose(device);
 }
 
-void Backlight::read_value()
+void Plane::create_tables()
 {
- memset(buffer,0,4);
- fgets(buffer,4,device);
- current=atoi(buffer);
+ this->destroy_tables();
+ columns=this->create_table(target_width);
+ rows=this->create_table(target_height);
+ this->fill_table(columns,this->get_frame_width(),target_width,1);
+ this->fill_table(rows,this->get_frame_height(),target_height,this->get_frame_width());
 }
 
-void Backlight::write_value(const unsigned char value)
+void Plane::copy_plane()
 {
- memset(buffer,0,4);
- sprintf(buffer,"%hhu",value);
- rewind(device);
- fputs(buffer,device);
+ memmove(target,plane,this->get_length());
 }
 
-void Backlight::set_level(const unsigned char level)
+void Plane::scale_double()
 {
- this->open_write();
- this->write_value(level);
- this->close_device();
-}
+ unsigned long int y,width,height;
+ size_t row;
+ unsigned short int *output;
+ width=this->get_frame_width();
+ height=this->get_frame_height();
+ row=static_cast<size_t>(target_width)*sizeof(unsigned short int);
+ output=target;
+ for (y=0;y<height;++y)
+ {
+  scale_row<2>(output,plane+this->get_offset(0,y),width);
+  memmove(output+target_width,output,row);
+  output+=2*target_width;
+ }
 
-unsigned char Backlight::correct_level(const unsigned char level) const
-{
- unsigned char value;
- value=level;
- if (value>maximum) value=maximum;
- if (value<minimum) value=minimum;
- return value;
 }
 
-unsigned char Backlight::get_minimum() const
+void Plane::scale_triple()
 {
- return minimum;
-}
+ unsigned long int y,width,height;
+ size_t row;
+ unsigned short int *output;
+ width=this->get_frame_width();
+ height=this->get_frame_height();
+ row=static_cast<size_t>(target_width)*sizeof(unsigned short int);
+ output=target;
+ for (y=0;y<height;++y)
+ {
+  scale_row<3>(output,plane+this->get_offset(0,y),width);
+  memmove(output+target_width,output,row);
+  memmove(output+2*target_width,output,row);
+  output+=3*target_width;
+ }
 
-unsigned char Backlight::get_maximum() const
-{
- return maximum;
 }
 
-unsigned char Backlight::get_level()
+void Plane::scale_plane()
 {
- this->open_read();
- this->read_value();
- this->close_device();
- return current;
+ unsigned long int y;
+ size_t row;
+ unsigned short int *output;
+ row=static_cast<size_t>(target_width)*sizeof(unsigned short int);
+ output=target;
+ for (y=0;y<target_height;++y)
+ {
+  if ((y>0)&&(rows[y]==rows[y-1]))
+  {
+   memmove(output,output-target_width,row);
+  }
+  else
+  {
+   scale_span<RGB565_Pixel>(reinterpret_cast<unsigned char*>(output),plane+rows[y],columns,target_width);
+  }
+  output+=target_width;
+ }
+
 }
 
-void Backlight::set_light(const unsigned char level)
+void Plane::create_plane(const unsigned long int width,const unsigned long int height,const unsigned long int surface_width,const unsigned long int surface_height,unsigned short int *surface_buffer)
 {
- this->set_level(this->correct_level(level));
+ this->set_size(width,height);
+ this->create_buffers();
+ plane=this->get_buffer();
+ target=surface_buffer;
+ target_width=surface_width;
+ target_height=surface_height;
+ this->get_factor();
+ this->create_tables();
 }
 
-void Backlight::increase_level()
+void Plane::transfer()
 {
- if (this->get_level()<maximum)
+ if (this->get_pixels()>0)
  {
-  current+=minimum;
-  this->set_light(current);
+  switch (factor)
+  {
+   case 1:
+   this->copy_plane();
+   break;
+   case 2:
+   this->scale_double();
+   break;
+   case 3:
+   this->scale_triple();
+   break;
+   default:
+   this->scale_plane();
+   break;
+  }
+
  }
 
 }
 
-void Backlight::decrease_level()
+Plane* Plane::get_handle()
 {
- if (this->get_level()>minimum)
- {
-  current-=minimum;
-  this->set_light(current);
- }
-
+ return this;
 }
 
-void Backlight::turn_off()
+Timer::Timer()
 {
- this->get_level();
- this->set_level(0);
+ interval=0;
+ start=time(NULL);
 }
 
-void Backlight::turn_on()
+Timer::~Timer()
 {
- this->set_light(current);
+
 }
 
-System::System()
+void Timer::set_timer(const double seconds)
 {
- srand(UINT_MAX);
+ interval=seconds;
+ start=time(NULL);
 }
 
-System::~System()
+bool Timer::check_timer()
 {
+ bool result;
+ result=false;
+ if (difftime(time(NULL),start)>=interval)
+ {
+  result=true;
+  start=time(NULL);
+ }
+ return result;
+}
 
+FPS::FPS()
+{
+ start=time(NULL);
+ current=0;
+ fps=0;
 }
 
-unsigned long int System::get_random(const unsigned long int number)
+FPS::~FPS()
 {
- return rand()%number;
+
 }
 
-void System::quit()
+void FPS::update_counter()
 {
- exit(EXIT_SUCCESS);
+ ++current;
+ if (difftime(time(NULL),start)>=1)
+ {
+  fps=current;
+  current=0;
+  start=time(NULL);
+ }
+
 }
 
-void System::run(const char *command)
+unsigned long int FPS::get_fps() const
 {
- system(command);
+ return fps;
 }
 
-char* System::read_environment(const char *variable)
+Render::Render()
 {
- return getenv(variable);
+ device=-1;
+ name=get_device("DINGUXGDK_FRAMEBUFFER",FRAMEBUFFER_DEVICE);
+ headless=false;
+ virtual_width=320;
+ virtual_height=240;
+ virtual_color=16;
+ format=FORMAT_RGB565;
+ pixel_size=sizeof(unsigned short int);
+ transfer=transfer_span<RGB565_Pixel>;
+ scale=scale_span<RGB565_Pixel>;
+ converted=NULL;
+ line=NULL;
+ plane=NULL;
+ whole.set_full();
+ vsync=true;
+ vsync_requested=false;
+ changed=false;
+ async=false;
+ running=false;
+ busy=false;
+ staging=NULL;
+ presenter=0;
+ handoffs=0;
+ wait_total=0;
+ wait_maximum=0;
+ pthread_mutex_init(&guard,NULL);
+ pthread_cond_init(&work,NULL);
+ pthread_cond_init(&done,NULL);
+ start=0;
+ page=0;
+ pages=1;
+ maximum_pages=PAGE_LIMIT;
+ memory_length=0;
+ mapping=NULL;
+ memory=NULL;
+ stale=NULL;
+ this->read_mode();
+ memset(&setting,0,sizeof(fb_var_screeninfo));
+ memset(&original,0,sizeof(fb_var_screeninfo));
+ memset(&configuration,0,sizeof(fb_fix_screeninfo));
 }
 
-void System::enable_logging(const char *name)
+Render::~Render()
 {
- if (freopen(name,"wt",stdout)==NULL)
+ this->stop_presenter();
+ this->restore_display();
+ this->unmap_memory();
+ if (device!=-1) close(device);
+ if (stale!=NULL)
  {
-  Halt("Can't create log file");
+  delete[] stale;
+  stale=NULL;
  }
-
+ if (staging!=NULL)
+ {
+  delete[] staging;
+  staging=NULL;
+ }
+ if (converted!=NULL)
+ {
+  delete[] converted;
+  converted=NULL;
+ }
+ if (line!=NULL)
+ {
+  delete[] line;
+  line=NULL;
+ }
+ pthread_cond_destroy(&done);
+ pthread_cond_destroy(&work);
+ pthread_mutex_destroy(&guard);
 }
 
-Filesystem::Filesystem()
+void Render::read_mode()
 {
+ const char *mode;
+ unsigned long int width,height,color;
+ mode=getenv("DINGUXGDK_FRAMEBUFFER_MODE");
+ if (mode!=NULL)
+ {
+  if (sscanf(mode,"%lux%lux%lu",&width,&height,&color)==3) this->set_mode(width,height,color);
+ }
 
 }
 
-Filesystem::~Filesystem()
+void Render::open_device()
 {
+ int flags;
+ if (device==-1)
+ {
+  headless=false;
+  if (strcmp(name,MEMORY_DEVICE)==0)
+  {
+   headless=true;
+  }
+  else
+  {
+   flags=O_RDWR;
+   if (strcmp(name,FRAMEBUFFER_DEVICE)!=0) flags|=O_CREAT;
+   device=open(name,flags,S_IRUSR|S_IWUSR|S_IRGRP|S_IROTH);
+   if (device==-1)
+   {
+    Halt("Can't get access to frame buffer");
+   }
+   headless=check_file(device);
+  }
+
+ }
 
 }
 
-bool Filesystem::file_exist(const char *name)
+void Render::create_virtual_configuration()
 {
- FILE *target;
- bool exist;
- exist=false;
- target=fopen(name,"rb");
- if (target!=NULL)
+ memset(&setting,0,sizeof(fb_var_screeninfo));
+ memset(&configuration,0,sizeof(fb_fix_screeninfo));
+ setting.xres=virtual_width;
+ setting.yres=virtual_height;
+ setting.xres_virtual=virtual_width;
+ setting.yres_virtual=virtual_height;
+ setting.bits_per_pixel=virtual_color;
+ setting.red.length=5;
+ setting.green.length=6;
+ setting.blue.length=5;
+ setting.red.offset=11;
+ setting.green.offset=5;
+ if (virtual_color==15)
  {
-  exist=true;
-  fclose(target);
+  setting.bits_per_pixel=16;
+  setting.green.length=5;
+  setting.red.offset=10;
  }
- return exist;
+ if (virtual_color==32)
+ {
+  setting.red.length=8;
+  setting.green.length=8;
+  setting.blue.length=8;
+  setting.red.offset=16;
+  setting.green.offset=8;
+ }
+ configuration.line_length=virtual_width*(setting.bits_per_pixel/CHAR_BIT);
+ configuration.smem_len=configuration.line_length*virtual_height;
 }
 
-bool Filesystem::delete_file(const char *name)
+void Render::read_base_configuration()
 {
- return remove(name)==0;
-}
+ if (ioctl(device,FBIOGET_VSCREENINFO,&setting)==-1)
+ {
+  Halt("Can't read framebuffer setting");
+ }
 
-Binary_File::Binary_File()
-{
- target=NULL;
 }
 
-Binary_File::~Binary_File()
+void Render::read_advanced_configuration()
 {
- if (target!=NULL)
+ if (ioctl(device,FBIOGET_FSCREENINFO,&configuration)==-1)
  {
-  fclose(target);
-  target=NULL;
+  Halt("Can't read framebuffer setting");
  }
 
 }
 
-void Binary_File::open_file(const char *name,const char *mode)
+void Render::read_configuration()
 {
- target=fopen(name,mode);
- if (target==NULL)
+ if (headless==true)
  {
-  Halt("Can't open the binary file");
+  this->create_virtual_configuration();
+ }
+ else
+ {
+  this->read_base_configuration();
+  this->read_advanced_configuration();
  }
 
 }
 
-void Binary_File::close()
+void Render::detect_format()
 {
- if (target!=NULL)
+ switch (setting.bits_per_pixel)
  {
-  fclose(target);
-  target=NULL;
+  case 16:
+  format=FORMAT_RGB565;
+  transfer=transfer_span<RGB565_Pixel>;
+  scale=scale_span<RGB565_Pixel>;
+  if (setting.green.length==5)
+  {
+   format=FORMAT_RGB555;
+   transfer=transfer_span<RGB555_Pixel>;
+   scale=scale_span<RGB555_Pixel>;
+  }
+  break;
+  case 32:
+  if ((setting.red.length!=8)||(setting.green.length!=8)||(setting.blue.length!=8)||(setting.green.offset!=8))
+  {
+   Halt("Unsupported pixel format");
+  }
+  if ((setting.red.offset==16)&&(setting.blue.offset==0))
+  {
+   format=FORMAT_XRGB8888;
+   transfer=transfer_span<XRGB8888_Pixel>;
+   scale=scale_span<XRGB8888_Pixel>;
+  }
+  else
+  {
+   if ((setting.red.offset!=0)||(setting.blue.offset!=16)) Halt("Unsupported pixel format");
+   format=FORMAT_XBGR8888;
+   transfer=transfer_span<XBGR8888_Pixel>;
+   scale=scale_span<XBGR8888_Pixel>;
+  }
+  break;
+  default:
+  Halt("Unsupported pixel format");
+  break;
  }
-
+ pixel_size=setting.bits_per_pixel/CHAR_BIT;
 }
 
-void Binary_File::set_position(const long int offset)
+void Render::create_converted()
 {
- fseek(target,offset,SEEK_SET);
+ if ((memory==NULL)&&((format!=FORMAT_RGB565)||(this->check_scale()==true))&&(converted==NULL))
+ {
+  try
+  {
+   converted=new unsigned char[static_cast<size_t>(setting.xres)*static_cast<size_t>(setting.yres)*pixel_size];
+  }
+  catch (...)
+  {
+   Halt("Can't allocate memory for pixel conversion buffer");
+  }
+
+ }
+
 }
 
-long int Binary_File::get_position()
+void Render::create_line()
 {
- return ftell(target);
+ if (line==NULL)
+ {
+  try
+  {
+   line=new unsigned char[static_cast<size_t>(setting.xres)*pixel_size];
+  }
+  catch (...)
+  {
+   Halt("Can't allocate memory for scale buffer");
+  }
+
+ }
+
 }
 
-long int Binary_File::get_length()
+void Render::get_start_offset()
 {
- long int result;
- fseek(target,0,SEEK_END);
- result=ftell(target);
- rewind(target);
- return result;
+ start=setting.xoffset*(setting.bits_per_pixel/CHAR_BIT)+setting.yoffset*configuration.line_length;
 }
 
-bool Binary_File::check_error()
+size_t Render::get_page_offset(const unsigned long int target) const
 {
- return ferror(target)!=0;
+ return static_cast<size_t>(setting.xoffset*(setting.bits_per_pixel/CHAR_BIT))+static_cast<size_t>(target)*static_cast<size_t>(setting.yres)*static_cast<size_t>(configuration.line_length);
 }
 
-Input_File::Input_File()
+bool Render::check_memory() const
 {
-
+ size_t row,need;
+ row=static_cast<size_t>(setting.xres)*pixel_size;
+ need=static_cast<size_t>(start)+static_cast<size_t>(configuration.line_length)*static_cast<size_t>(setting.yres);
+ return (configuration.line_length>=row)&&(need<=configuration.smem_len);
 }
 
-Input_File::~Input_File()
+void Render::map_memory()
 {
+ size_t shift;
+ void *target;
+ this->unmap_memory();
+ if (this->check_memory()==true)
+ {
+  shift=static_cast<size_t>(configuration.smem_start%static_cast<unsigned long int>(sysconf(_SC_PAGESIZE)));
+  memory_length=static_cast<size_t>(configuration.smem_len)+shift;
+  if (device==-1)
+  {
+   target=mmap(NULL,memory_length,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_ANONYMOUS,-1,0);
+  }
+  else
+  {
+   if (headless==true)
+   {
+    if (ftruncate(device,static_cast<off_t>(memory_length))==-1) Halt("Can't resize frame buffer file");
+   }
+   target=mmap(NULL,memory_length,PROT_READ|PROT_WRITE,MAP_SHARED,device,0);
+  }
+  if (target!=MAP_FAILED)
+  {
+   mapping=static_cast<unsigned char*>(target);
+   memory=mapping+shift;
+  }
 
-}
+ }
+ if ((memory==NULL)&&(device==-1))
+ {
+  Halt("Can't allocate memory for frame buffer");
+ }
 
-void Input_File::open(const char *name)
-{
- this->close();
- this->open_file(name,"rb");
 }
 
-void Input_File::read(void *buffer,const size_t length)
+void Render::unmap_memory()
 {
- fread(buffer,sizeof(char),length,target);
+ if (mapping!=NULL)
+ {
+  munmap(mapping,memory_length);
+  mapping=NULL;
+  memory=NULL;
+ }
+ memory_length=0;
 }
 
-Output_File::Output_File()
+unsigned long int Render::get_page_capacity() const
 {
-
+ size_t page_length;
+ unsigned long int amount;
+ amount=1;
+ page_length=static_cast<size_t>(configuration.line_length)*static_cast<size_t>(setting.yres);
+ if (page_length>0) amount=static_cast<unsigned long int>(configuration.smem_len/page_length);
+ if (amount>maximum_pages) amount=maximum_pages;
+ if (amount==0) amount=1;
+ return amount;
 }
 
-Output_File::~Output_File()
+void Render::resize_virtual_screen(const unsigned long int amount)
 {
+ fb_var_screeninfo target;
+ if (setting.yres_virtual<setting.yres*amount)
+ {
+  target=setting;
+  target.yres_virtual=setting.yres*amount;
+  target.yoffset=0;
+  if (ioctl(device,FBIOPUT_VSCREENINFO,&target)==0)
+  {
+   changed=true;
+   this->read_configuration();
+  }
+
+ }
 
 }
 
-void Output_File::open(const char *name)
+bool Render::pan_display(const unsigned long int target)
 {
- this->close();
- this->open_file(name,"wb");
+ fb_var_screeninfo position;
+ bool result;
+ result=false;
+ position=setting;
+ position.yoffset=target*setting.yres;
+ if (ioctl(device,FBIOPAN_DISPLAY,&position)==0)
+ {
+  setting.yoffset=position.yoffset;
+  result=true;
+ }
+ return result;
 }
 
-void Output_File::create_temp()
+void Render::create_stale_regions()
 {
- this->close();
- target=tmpfile();
- if (target==NULL)
+ if (stale!=NULL)
  {
-  Halt("Can't create a temporary file");
+  delete[] stale;
+  stale=NULL;
+ }
+ try
+ {
+  stale=new Dirty_Regions[pages];
+ }
+ catch (...)
+ {
+  Halt("Can't allocate memory for page region lists");
  }
 
 }
 
-void Output_File::write(void *buffer,const size_t length)
+void Render::prepare_pages()
 {
- fwrite(buffer,sizeof(char),length,target);
-}
+ unsigned long int amount;
+ page=0;
+ pages=1;
+ if ((memory!=NULL)&&(configuration.ypanstep!=0))
+ {
+  amount=this->get_page_capacity();
+  if (amount>1)
+  {
+   this->resize_virtual_screen(amount);
+   if (setting.yres>0)
+   {
+    if (amount>setting.yres_virtual/setting.yres) amount=setting.yres_virtual/setting.yres;
+   }
+   if (amount>1)
+   {
+    if (this->pan_display(0)==true) pages=amount;
+   }
 
-void Output_File::flush()
-{
- fflush(target);
-}
+  }
 
-Audio::Audio()
-{
- memset(&head,0,44);
+ }
+ this->get_start_offset();
+ this->create_stale_regions();
 }
 
-Audio::~Audio()
+void Render::restore_display()
 {
+ if (device!=-1)
+ {
+  if (changed==true)
+  {
+   ioctl(device,FBIOPUT_VSCREENINFO,&original);
+   changed=false;
+  }
+  else
+  {
+   if (pages>1) this->pan_display(0);
+  }
 
-}
+ }
 
-void Audio::read_head()
-{
- target.read(&head,44);
 }
 
-void Audio::check_riff_signature()
+void Render::wait_vsync()
 {
- if (strncmp(head.riff_signature,"RIFF",4)!=0)
+ __u32 screen;
+ screen=0;
+ if (vsync==true)
  {
-  Halt("Incorrect riff signature");
+  if (ioctl(device,FBIO_WAITFORVSYNC,&screen)==-1) vsync=false;
  }
 
 }
 
-void Audio::check_wave_signature()
+void Render::flip_page(const unsigned short int *source,const Dirty_Regions &regions)
 {
- if (strncmp(head.wave_signature,"WAVE",4)!=0)
+ unsigned long int next,index;
+ next=(page+1)%pages;
+ stale[next].add_regions(regions);
+ this->copy_regions(memory+this->get_page_offset(next),source,stale[next]);
+ if (this->pan_display(next)==true)
  {
-  Halt("Incorrect wave signature");
+  stale[next].clear();
+  for (index=0;index<pages;++index)
+  {
+   if (index!=next) stale[index].add_regions(regions);
+  }
+  page=next;
+  this->wait_vsync();
+ }
+ else
+ {
+  pages=1;
+  page=0;
+  this->pan_display(0);
+  this->get_start_offset();
+  this->copy_frame(memory+start,source);
  }
 
 }
 
-void Audio::check_type() const
+void Render::copy_region(unsigned char *target,const unsigned short int *source,const Dirty_Region &region)
 {
- if (head.type!=1)
+ unsigned long int y;
+ size_t row,pitch,amount;
+ row=static_cast<size_t>(this->get_frame_width());
+ pitch=static_cast<size_t>(configuration.line_length);
+ amount=static_cast<size_t>(region.right-region.left);
+ source+=this->get_offset(region.left,region.top);
+ target+=static_cast<size_t>(region.top)*pitch+static_cast<size_t>(region.left)*pixel_size;
+ for (y=region.top;y<region.bottom;++y)
  {
-  Halt("Incorrect type of wave file");
+  transfer(target,source,amount);
+  target+=pitch;
+  source+=row;
  }
 
 }
 
-void Audio::check_bits() const
+bool Render::check_scale() const
 {
- if (head.bits!=16)
+ bool scaled;
+ scaled=false;
+ if (plane!=NULL) scaled=plane->factor!=1;
+ return scaled;
+}
+
+void Render::scale_frame(unsigned char *target,const unsigned short int *source,const size_t pitch)
+{
+ unsigned long int y,height;
+ size_t width,row;
+ height=this->get_frame_height();
+ width=static_cast<size_t>(this->get_frame_width());
+ row=width*pixel_size;
+ for (y=0;y<height;++y)
  {
-  Halt("Incorrect amount of sound bits");
+  if ((y==0)||(plane->rows[y]!=plane->rows[y-1]))
+  {
+   scale(line,source+plane->rows[y],plane->columns,width);
+  }
+  memmove(target,line,row);
+  target+=pitch;
  }
 
 }
 
-void Audio::check_channels() const
+void Render::copy_frame(unsigned char *target,const unsigned short int *source)
 {
- if ((head.channels==0)||(head.channels>2))
+ unsigned long int y,height;
+ size_t row,pitch;
+ height=this->get_frame_height();
+ row=static_cast<size_t>(this->get_frame_width());
+ pitch=static_cast<size_t>(configuration.line_length);
+ if (this->check_scale()==true)
  {
-  Halt("Incorrect number of audio channels");
+  this->scale_frame(target,source,pitch);
  }
+ else
+ {
+  if (pitch==row*pixel_size)
+  {
+   transfer(target,source,this->get_pixels());
+  }
+  else
+  {
+   for (y=0;y<height;++y)
+   {
+    transfer(target,source,row);
+    target+=pitch;
+    source+=row;
+   }
 
-}
+  }
 
-void Audio::check_wave()
-{
- this->check_riff_signature();
- this->check_wave_signature();
- this->check_type();
- this->check_bits();
- this->check_channels();
-}
+ }
 
-Audio* Audio::get_handle()
-{
- return this;
 }
 
-size_t Audio::get_total() const
+void Render::copy_regions(unsigned char *target,const unsigned short int *source,const Dirty_Regions &regions)
 {
- return static_cast<size_t>(head.date_length);
-}
+ size_t index;
+ if (regions.check_full()==true)
+ {
+  this->copy_frame(target,source);
+ }
+ else
+ {
+  for (index=0;index<regions.get_amount();++index)
+  {
+   this->copy_region(target,source,regions.get_region(index));
+  }
 
-size_t Audio::get_block() const
-{
- return static_cast<size_t>(head.block_length);
-}
+ }
 
-unsigned long int Audio::get_rate() const
-{
- return head.rate;
 }
 
-unsigned short int Audio::get_channels() const
+void Render::write_band(const unsigned short int *source,const unsigned long int top,const unsigned long int bottom)
 {
- return head.channels;
+ size_t row,amount;
+ const void *data;
+ row=static_cast<size_t>(this->get_frame_width())*pixel_size;
+ amount=static_cast<size_t>(bottom-top)*static_cast<size_t>(this->get_frame_width());
+ source+=this->get_offset(0,top);
+ data=source;
+ if (format!=FORMAT_RGB565)
+ {
+  transfer(converted,source,amount);
+  data=converted;
+ }
+ lseek(device,static_cast<off_t>(start)+static_cast<off_t>(top)*static_cast<off_t>(row),SEEK_SET);
+ write(device,data,static_cast<size_t>(bottom-top)*row);
 }
 
-unsigned short int Audio::get_bits() const
+void Render::write_plane(const unsigned short int *source)
 {
- return head.bits;
+ size_t row;
+ row=static_cast<size_t>(this->get_frame_width())*pixel_size;
+ this->scale_frame(converted,source,row);
+ lseek(device,static_cast<off_t>(start),SEEK_SET);
+ write(device,converted,static_cast<size_t>(this->get_frame_height())*row);
 }
 
-void Audio::load_wave(const char *name)
+void Render::write_frame(const unsigned short int *source,const Dirty_Regions &regions)
 {
- target.open(name);
- this->read_head();
- this->check_wave();
+ size_t index;
+ if (this->check_scale()==true)
+ {
+  this->write_plane(source);
+ }
+ else
+ {
+  if (regions.check_full()==true)
+  {
+   this->write_band(source,0,this->get_frame_height());
+  }
+  else
+  {
+   for (index=0;index<regions.get_amount();++index)
+   {
+    this->write_band(source,regions.get_region(index).top,regions.get_region(index).bottom);
+   }
+
+  }
+
+ }
+
 }
 
-void Audio::read_data(void *buffer,const size_t length)
+void Render::present(const unsigned short int *source,const Dirty_Regions &regions)
 {
- target.read(buffer,length);
+ if (pages>1)
+ {
+  this->flip_page(source,regions);
+ }
+ else
+ {
+  if (vsync_requested==true) this->wait_vsync();
+  if (memory!=NULL)
+  {
+   this->copy_regions(memory+start,source,regions);
+  }
+  else
+  {
+   this->write_frame(source,regions);
+  }
+
+ }
+
 }
 
-void Audio::go_start()
+void Render::update_statistic(const double wait)
 {
- target.set_position(44);
+ ++handoffs;
+ wait_total+=wait;
+ if (wait>wait_maximum) wait_maximum=wait;
 }
 
-Player::Player()
+size_t Render::get_source_pixels()
 {
- sound=NULL;
- target=NULL;
- buffer=NULL;
- index=0;
- length=0;
+ size_t amount;
+ amount=this->get_pixels();
+ if (plane!=NULL) amount=plane->get_pixels();
+ return amount;
 }
 
-Player::~Player()
+void Render::copy_staging()
 {
- if (buffer!=NULL) delete[] buffer;
+ size_t index,row,amount;
+ unsigned long int y;
+ const Dirty_Region *region;
+ unsigned short int *source;
+ unsigned short int *target;
+ if (plane!=NULL)
+ {
+  memmove(staging,plane->get_buffer(),plane->get_pixels()*sizeof(unsigned short int));
+  pending.set_full();
+ }
+ else
+ {
+  if (this->get_dirty().check_full()==true)
+  {
+   memmove(staging,this->get_buffer(),this->get_length());
+  }
+  else
+  {
+   row=static_cast<size_t>(this->get_frame_width());
+   for (index=0;index<this->get_dirty().get_amount();++index)
+   {
+    region=&this->get_dirty().get_region(index);
+    amount=static_cast<size_t>(region->right-region->left)*sizeof(unsigned short int);
+    source=this->get_buffer()+this->get_offset(region->left,region->top);
+    target=staging+this->get_offset(region->left,region->top);
+    for (y=region->top;y<region->bottom;++y)
+    {
+     memmove(target,source,amount);
+     source+=row;
+     target+=row;
+    }
+
+   }
+
+  }
+  pending.add_regions(this->get_dirty());
+ }
+
 }
 
-void Player::configure_player(Audio *audio)
+void Render::hand_off()
 {
- index=0;
- target=audio;
- length=target->get_total();
+ double begin;
+ pthread_mutex_lock(&guard);
+ begin=get_time();
+ while (busy==true)
+ {
+  pthread_cond_wait(&done,&guard);
+ }
+ this->update_statistic(get_time()-begin);
+ this->copy_staging();
+ busy=true;
+ pthread_cond_signal(&work);
+ pthread_mutex_unlock(&guard);
 }
 
-void Player::clear_buffer()
+void Render::run_presenter()
 {
- if (buffer!=NULL)
+ while (true)
  {
-  delete[] buffer;
-  buffer=NULL;
+  pthread_mutex_lock(&guard);
+  while ((running==true)&&(busy==false))
+  {
+   pthread_cond_wait(&work,&guard);
+  }
+  if (busy==false)
+  {
+   pthread_mutex_unlock(&guard);
+   break;
+  }
+  pthread_mutex_unlock(&guard);
+  this->present(staging,pending);
+  pthread_mutex_lock(&guard);
+  pending.clear();
+  busy=false;
+  pthread_cond_signal(&done);
+  pthread_mutex_unlock(&guard);
  }
 
 }
 
-void Player::create_buffer()
+void Render::create_staging()
 {
+ if (staging!=NULL)
+ {
+  delete[] staging;
+  staging=NULL;
+ }
  try
  {
-  buffer=new char[sound->get_length()];
+  staging=new unsigned short int[this->get_source_pixels()];
  }
  catch (...)
  {
-  Halt("Can't allocate memory for audio buffer");
+  Halt("Can't allocate memory for present buffer");
  }
-
+ if (plane!=NULL)
+ {
+  memmove(staging,plane->get_buffer(),plane->get_pixels()*sizeof(unsigned short int));
+ }
+ else
+ {
+  memmove(staging,this->get_buffer(),this->get_length());
+ }
+ pending.set_full();
 }
 
-void Player::rewind_audio()
+void Render::start_presenter()
 {
- index=0;
- target->go_start();
+ if ((running==false)&&(this->get_buffer()!=NULL))
+ {
+  this->create_staging();
+  busy=false;
+  running=true;
+  if (pthread_create(&presenter,NULL,present_frames,this)!=0)
+  {
+   Halt("Can't start present thread");
+  }
+
+ }
+
 }
 
-bool Player::is_end() const
+void Render::stop_presenter()
 {
- bool end_audio;
- end_audio=false;
- if (index==length)
+ if (running==true)
  {
-  end_audio=true;
+  pthread_mutex_lock(&guard);
+  running=false;
+  pthread_cond_signal(&work);
+  pthread_mutex_unlock(&guard);
+  pthread_join(presenter,NULL);
  }
- return end_audio;
+
 }
 
-void Player::load(Audio *audio)
+void Render::prepare_render()
 {
- this->configure_player(audio);
- this->clear_buffer();
- this->create_buffer();
+ this->open_device();
+ this->read_configuration();
+ this->detect_format();
+ original=setting;
+ this->get_start_offset();
+ this->map_memory();
+ this->create_converted();
+ this->prepare_pages();
 }
 
-void Player::initialize(Sound *target)
+void Render::prepare_presenter()
 {
- sound=target;
+ if (async==true) this->start_presenter();
 }
 
-void Player::play()
+void Render::refresh()
 {
- size_t block;
- size_t elapsed;
- block=sound->get_length();
- if (index<length)
+ if (running==true)
  {
-  if (sound->check_busy()==false)
+  this->hand_off();
+ }
+ else
+ {
+  if (plane!=NULL)
   {
-   elapsed=length-index;
-   if (block>elapsed) block=elapsed;
-   target->read_data(buffer,block);
-   index+=sound->send(buffer,block);
+   this->present(plane->get_buffer(),whole);
+  }
+  else
+  {
+   this->present(this->get_buffer(),this->get_dirty());
   }
 
  }
+ this->clear_dirty();
+}
+
+unsigned long int Render::get_width() const
+{
+ return setting.xres;
+}
 
+unsigned long int Render::get_height() const
+{
+ return setting.yres;
 }
 
-void Player::loop()
+unsigned long int Render::get_color() const
 {
- if (this->is_end())
+ return setting.bits_per_pixel;
+}
+
+PIXEL_FORMAT Render::get_format() const
+{
+ return format;
+}
+
+void Render::set_device(const char *target)
+{
+ if (device==-1)
  {
-  this->rewind_audio();
+  name=target;
  }
  else
  {
-  this->play();
+  Halt("Can't change device after it was opened");
  }
 
 }
 
-Primitive::Primitive()
+void Render::set_mode(const unsigned long int width,const unsigned long int height,const unsigned long int color)
 {
- surface=NULL;
- color.red=0;
- color.green=0;
- color.blue=0;
+ if ((width>0)&&(height>0)&&(color>0))
+ {
+  virtual_width=width;
+  virtual_height=height;
+  virtual_color=color;
+ }
+
 }
 
-Primitive::~Primitive()
+bool Render::is_headless() const
 {
-
+ return headless;
 }
 
-void Primitive::initialize(Screen *screen)
+void Render::set_pages(const unsigned long int amount)
 {
- surface=screen;
+ bool active;
+ maximum_pages=amount;
+ if (maximum_pages==0) maximum_pages=1;
+ if (maximum_pages>PAGE_LIMIT) maximum_pages=PAGE_LIMIT;
+ if (stale!=NULL)
+ {
+  active=running;
+  this->stop_presenter();
+  if (pages>1) this->pan_display(0);
+  this->prepare_pages();
+  this->invalidate();
+  if (active==true) this->start_presenter();
+ }
+
 }
 
-void Primitive::set_color(const unsigned char red,const unsigned char green,const unsigned char blue)
+unsigned long int Render::get_pages() const
 {
- color.red=red;
- color.green=green;
- color.blue=blue;
+ return pages;
 }
 
-void Primitive::draw_line(const unsigned long int x1,const unsigned long int y1,const unsigned long int x2,const unsigned long int y2)
+void Render::set_vsync(const bool enabled)
 {
- unsigned long int delta_x,delta_y,index,steps;
- float x,y,shift_x,shift_y;
- if (x1>x2)
- {
-  delta_x=x1-x2;
- }
- else
+ pthread_mutex_lock(&guard);
+ while (busy==true)
  {
-  delta_x=x2-x1;
+  pthread_cond_wait(&done,&guard);
  }
- if (y1>y2)
+ vsync=enabled;
+ vsync_requested=enabled;
+ pthread_mutex_unlock(&guard);
+}
+
+bool Render::get_vsync() const
+{
+ return vsync;
+}
+
+void Render::set_async(const bool enabled)
+{
+ async=enabled;
+ if (async==true)
  {
-  delta_y=y1-y2;
+  this->start_presenter();
  }
  else
  {
-  delta_y=y2-y1;
- }
- steps=delta_x;
- if (steps<delta_y) steps=delta_y;
- x=x1;
- y=y1;
- shift_x=static_cast<float>(delta_x)/static_cast<float>(steps);
- shift_y=static_cast<float>(delta_y)/static_cast<float>(steps);
- for (index=steps;index>0;--index)
- {
-  x+=shift_x;
-  y+=shift_y;
-  surface->draw_pixel(x,y,color.red,color.green,color.blue);
+  this->stop_presenter();
  }
 
 }
 
-void Primitive::draw_rectangle(const unsigned long int x,const unsigned long int y,const unsigned long int width,const unsigned long int height)
+bool Render::get_async() const
 {
- unsigned long int stop_x,stop_y;
- stop_x=x+width;
- stop_y=y+height;
- this->draw_line(x,y,stop_x,y);
- this->draw_line(x,stop_y,stop_x,stop_y);
- this->draw_line(x,y,x,stop_y);
- this->draw_line(stop_x,y,stop_x,stop_y);
+ return async;
 }
 
-void Primitive::draw_filled_rectangle(const unsigned long int x,const unsigned long int y,const unsigned long int width,const unsigned long int height)
+unsigned long int Render::get_handoffs() const
 {
- unsigned long int step_x,step_y,stop_x,stop_y;
- stop_x=x+width;
- stop_y=y+height;
- for (step_x=x;step_x<stop_x;++step_x)
+ return handoffs;
+}
+
+double Render::get_wait_total() const
+{
+ return wait_total;
+}
+
+double Render::get_wait_maximum() const
+{
+ return wait_maximum;
+}
+
+void Render::set_plane(Plane *target)
+{
+ bool active;
+ if (target!=NULL)
  {
-  for (step_y=y;step_y<stop_y;++step_y)
+  if ((target->target_width!=this->get_frame_width())||(target->target_height!=this->get_frame_height()))
   {
-   surface->draw_pixel(step_x,step_y,color.red,color.green,color.blue);
+   Halt("Plane size doesn't match screen size");
   }
+  if (target->get_pixels()==0) Halt("Invalid plane size");
 
  }
+ active=running;
+ this->stop_presenter();
+ plane=target;
+ this->create_converted();
+ this->create_line();
+ this->invalidate();
+ if (active==true) this->start_presenter();
+}
 
+Plane* Render::get_plane()
+{
+ return plane;
 }
 
-Image::Image()
+Screen::Screen()
 {
- width=0;
- height=0;
- data=NULL;
+
 }
 
-Image::~Image()
+Screen::~Screen()
 {
- if (data!=NULL)
- {
-  delete[] data;
-  data=NULL;
- }
 
 }
 
-unsigned char *Image::create_buffer(const size_t length)
+void Screen::initialize()
 {
- unsigned char *result;
- result=NULL;
+ this->prepare_render();
+ this->set_size(this->get_width(),this->get_height());
+ this->create_buffers();
+ this->prepare_presenter();
+}
+
+void Screen::update()
+{
+ this->refresh();
+ this->update_counter();
+}
+
+Screen* Screen::get_handle()
+{
+ return this;
+}
+
+Gamepad::Gamepad()
+{
+ current=NULL;
+ preversion=NULL;
+ device=-1;
+ name=get_device("DINGUXGDK_GAMEPAD",GAMEPAD_DEVICE);
+ replay=false;
+ pending=false;
+ replay_start=0;
+ event_start=-1;
+ length=sizeof(input_event);
+ memset(&input,0,length);
+}
+
+Gamepad::~Gamepad()
+{
+ if (device!=-1) close(device);
+ if (current!=NULL) delete[] current;
+ if (preversion!=NULL) delete[] preversion;
+}
+
+unsigned char *Gamepad::get_memory(const char *message)
+{
+ unsigned char *buffer;
+ buffer=NULL;
  try
  {
-  result=new unsigned char[length];
+  buffer=new unsigned char[BUTTON_AMOUNT];
  }
  catch (...)
  {
-  Halt("Can't allocate memory for image buffer");
+  Halt(message);
  }
- return result;
+ return buffer;
 }
 
-void Image::clear_buffer()
+void Gamepad::clear_buffer(unsigned char *target)
 {
- if (data!=NULL)
+ size_t index;
+ for (index=0;index<BUTTON_AMOUNT;++index)
  {
-  delete[] data;
-  data=NULL;
+  target[index]=GAMEPAD_RELEASE;
  }
 
 }
 
-void Image::load_tga(const char *name)
+unsigned char *Gamepad::create_buffer(const char *message)
 {
- Input_File target;
- size_t index,position,amount,compressed_length,uncompressed_length;
- unsigned char *compressed;
- unsigned char *uncompressed;
- TGA_head head;
- TGA_map color_map;
- TGA_image image;
- this->clear_buffer();
- target.open(name);
- compressed_length=static_cast<size_t>(target.get_length()-18);
- target.read(&head,3);
- target.read(&color_map,5);
- target.read(&image,10);
- if ((head.color_map!=0)||(image.color!=24))
+ unsigned char *buffer;
+ buffer=this->get_memory(message);
+ this->clear_buffer(buffer);
+ return buffer;
+}
+
+void Gamepad::create_buffers()
+{
+ current=this->create_buffer("Can't allocate memory for primary input buffer");
+ preversion=this->create_buffer("Can't allocate memory for secondary input buffer");
+}
+
+void Gamepad::open_device()
+{
+ device=open(name,O_RDONLY|O_NONBLOCK|O_NOCTTY);
+ if (device==-1)
  {
-  Halt("Invalid image format");
+  Halt("Can't get access to gamepad");
  }
- if (head.type!=2)
- {
-  if (head.type!=10)
-  {
-   Halt("Invalid image format");
-  }
+ replay=check_file(device);
+ pending=false;
+ event_start=-1;
+ replay_start=get_time();
+}
 
- }
- index=0;
- position=0;
- width=image.width;
- height=image.height;
- uncompressed_length=this->get_length();
- uncompressed=this->create_buffer(uncompressed_length);
- if (head.type==2)
+unsigned char Gamepad::get_state() const
+{
+ unsigned char state;
+ state=GAMEPAD_RELEASE;
+ if (input.value!=GAMEPAD_RELEASE)
  {
-  target.read(uncompressed,uncompressed_length);
+  state=GAMEPAD_PRESS;
  }
- if (head.type==10)
+ return state;
+}
+
+GAMEPAD_BUTTONS Gamepad::get_button() const
+{
+ GAMEPAD_BUTTONS button;
+ button=BUTTON_UP;
+ switch (input.code)
  {
-  compressed=this->create_buffer(compressed_length);
-  target.read(compressed,compressed_length);
-  while(index<uncompressed_length)
-  {
-   if (compressed[position]<128)
+  case KEY_UP:
+  button=BUTTON_UP;
+  break;
+  case KEY_DOWN:
+  button=BUTTON_DOWN;
+  break;
+  case KEY_LEFT:
+  button=BUTTON_LEFT;
+  break;
+  case KEY_RIGHT:
+  button=BUTTON_RIGHT;
+  break;
+  case KEY_LEFTCTRL:
+  button=BUTTON_A;
+  break;
+  case KEY_LEFTALT:
+  button=BUTTON_B;
+  break;
+  case KEY_SPACE:
+  button=BUTTON_X;
+  break;
+  case KEY_LEFTSHIFT:
+  button=BUTTON_Y;
+  break;
+  case KEY_BACKSPACE:
+  button=BUTTON_R;
+  break;
+  case KEY_TAB:
+  button=BUTTON_L;
+  break;
+  case KEY_ENTER:
+  button=BUTTON_START;
+  break;
+  case KEY_ESC:
+  button=BUTTON_MENU;
+  break;
+  case KEY_2:
+  button=BUTTON_C;
+  break;
+  case KEY_1:
+  button=BUTTON_Z;
+  break;
+  case KEY_POWER:
+  button=BUTTON_POWER;
+  break;
+  case KEY_PAUSE:
+  button=BUTTON_HOLD;
+  break;
+ }
+ return button;
+}
+
+bool Gamepad::check_state(const GAMEPAD_BUTTONS button,const unsigned char state)
+{
+ bool result;
+ result=false;
+ if (current[button]==state)
+ {
+  if (preversion[button]!=state) result=true;
+ }
+ preversion[button]=current[button];
+ return result;
+}
+
+double Gamepad::get_event_time() const
+{
+ return static_cast<double>(input.time.tv_sec)+static_cast<double>(input.time.tv_usec)/1000000.0;
+}
+
+void Gamepad::process_event()
+{
+ if (input.type==EV_KEY)
+ {
+  current[this->get_button()]=this->get_state();
+ }
+
+}
+
+void Gamepad::read_events()
+{
+ while (read(device,&input,length)>0)
+ {
+  this->process_event();
+ }
+
+}
+
+void Gamepad::replay_events()
+{
+ double elapsed;
+ elapsed=get_time()-replay_start;
+ while (true)
+ {
+  if (pending==false)
+  {
+   if (read(device,&input,length)!=static_cast<ssize_t>(length)) break;
+   pending=true;
+   if (event_start<0) event_start=this->get_event_time();
+  }
+  if (this->get_event_time()-event_start>elapsed) break;
+  this->process_event();
+  pending=false;
+ }
+
+}
+
+void Gamepad::set_device(const char *target)
+{
+ if (device==-1)
+ {
+  name=target;
+ }
+ else
+ {
+  Halt("Can't change device after it was opened");
+ }
+
+}
+
+void Gamepad::initialize()
+{
+ this->open_device();
+ this->create_buffers();
+}
+
+void Gamepad::update()
+{
+ if (replay==true)
+ {
+  this->replay_events();
+ }
+ else
+ {
+  this->read_events();
+ }
+
+}
+
+bool Gamepad::check_hold(const GAMEPAD_BUTTONS button)
+{
+ preversion[button]=current[button];
+ return current[button]!=GAMEPAD_RELEASE;
+}
+
+bool Gamepad::check_press(const GAMEPAD_BUTTONS button)
+{
+ return this->check_state(button,GAMEPAD_PRESS);
+}
+
+bool Gamepad::check_release(const GAMEPAD_BUTTONS button)
+{
+ return this->check_state(button,GAMEPAD_RELEASE);
+}
+
+Memory::Memory()
+{
+ memset(&information,0,sizeof(struct sysinfo));
+}
+
+Memory::~Memory()
+{
+
+}
+
+void Memory::read_system_information()
+{
+ if (sysinfo(&information)==-1)
+ {
+  Halt("Can't read system information");
+ }
+
+}
+
+unsigned long int Memory::get_total_memory()
+{
+ this->read_system_information();
+ return information.totalram*information.mem_unit;
+}
+
+unsigned long int Memory::get_free_memory()
+{
+ this->read_system_information();
+ return information.freeram*information.mem_unit;
+}
+
+Sound::Sound()
+{
+ internal=NULL;
+ name=get_device("DINGUXGDK_SOUND",SOUND_DEVICE);
+ record=false;
+ if (get_device("DINGUXGDK_SOUND_RECORD",NULL)!=NULL)
+ {
+  name=get_device("DINGUXGDK_SOUND_RECORD",NULL);
+  record=true;
+ }
+ buffer_length=0;
+ stream=0;
+}
+
+Sound::~Sound()
+{
+ OSS_BACKEND::run_stream=false;
+ if (stream!=0) pthread_join(stream,NULL);
+}
+
+void Sound::open_device()
+{
+ int flags;
+ flags=O_WRONLY;
+ if (record==true) flags|=O_CREAT|O_TRUNC;
+ OSS_BACKEND::sound_device=open(name,flags,S_IRWXU|S_IRWXG|S_IRWXO);
+ if (OSS_BACKEND::sound_device==-1)
+ {
+  Halt("Can't get access to sound card");
+ }
+
+}
+
+bool Sound::check_sink() const
+{
+ int formats;
+ bool result;
+ result=check_file(OSS_BACKEND::sound_device);
+ if (result==false)
+ {
+  if (ioctl(OSS_BACKEND::sound_device,SNDCTL_DSP_GETFMTS,&formats)==-1) result=(errno==ENOTTY);
+ }
+ return result;
+}
+
+void Sound::prepare_sink(const int rate)
+{
+ buffer_length=SINK_BUFFER_LENGTH;
+ if (check_file(OSS_BACKEND::sound_device)==true)
+ {
+  OSS_BACKEND::sound_file=true;
+  OSS_BACKEND::sound_rate=rate;
+  OSS_BACKEND::sound_written=0;
+  oss_write_head(OSS_BACKEND::sound_device,rate,0);
+ }
+
+}
+
+void Sound::set_format()
+{
+ int format;
+ format=AFMT_S16_LE;
+ if (ioctl(OSS_BACKEND::sound_device,SNDCTL_DSP_SETFMT,&format)==-1)
+ {
+  Halt("Can't set sound format");
+ }
+
+}
+
+void Sound::set_channels()
+{
+ int channels;
+ channels=SOUND_CHANNELS;
+ if (ioctl(OSS_BACKEND::sound_device,SNDCTL_DSP_CHANNELS,&channels)==-1)
+ {
+  Halt("Can't set number of audio channels");
+ }
+
+}
+
+void Sound::set_rate(const int rate)
+{
+ if (ioctl(OSS_BACKEND::sound_device,SNDCTL_DSP_SPEED,&rate)==-1)
+ {
+  Halt("Can't set sample rate");
+ }
+
+}
+
+void Sound::get_buffer_length()
+{
+ audio_buf_info configuration;
+ memset(&configuration,0,sizeof(audio_buf_info));
+ if (ioctl(OSS_BACKEND::sound_device,SNDCTL_DSP_GETOSPACE,&configuration)==-1)
+ {
+  Halt("Can't read configuration of sound buffer");
+ }
+ buffer_length=static_cast<size_t>(configuration.fragstotal)*static_cast<size_t>(configuration.fragsize);
+}
+
+void Sound::configure_sound_card(const int rate)
+{
+ this->open_device();
+ if (this->check_sink()==true)
+ {
+  this->prepare_sink(rate);
+ }
+ else
+ {
+  this->set_format();
+  this->set_rate(rate);
+  this->set_channels();
+  this->get_buffer_length();
+ }
+
+}
+
+void Sound::start_stream()
+{
+ if (pthread_create(&stream,NULL,oss_play_sound,internal)!=0)
+ {
+  Halt("Can't start sound stream");
+ }
+
+}
+
+void Sound::create_buffer()
+{
+ internal=static_cast<char*>(calloc(buffer_length,sizeof(char)));
+ if (internal==NULL)
+ {
+  Halt("Can't allocate memory for sound buffer");
+ }
+
+}
+
+void Sound::set_device(const char *target)
+{
+ if (OSS_BACKEND::sound_device==-1)
+ {
+  name=target;
+  record=false;
+ }
+ else
+ {
+  Halt("Can't change device after it was opened");
+ }
+
+}
+
+void Sound::set_record(const char *target)
+{
+ if (OSS_BACKEND::sound_device==-1)
+ {
+  name=target;
+  record=true;
+ }
+ else
+ {
+  Halt("Can't change device after it was opened");
+ }
+
+}
+
+void Sound::initialize(const int rate)
+{
+ this->configure_sound_card(rate);
+ this->create_buffer();
+ this->start_stream();
+}
+
+bool Sound::check_busy()
+{
+ return OSS_BACKEND::do_play;
+}
+
+size_t Sound::get_length() const
+{
+ return buffer_length;
+}
+
+size_t Sound::send(char *buffer,const size_t length)
+{
+ size_t amount;
+ if (OSS_BACKEND::do_play)
+ {
+  amount=0;
+ }
+ else
+ {
+  amount=buffer_length;
+  if (length<buffer_length) amount=length;
+  memmove(internal,buffer,amount);
+  OSS_BACKEND::sound_buffer_length=amount;
+  OSS_BACKEND::do_play=true;
+ }
+ return amount;
+}
+
+Sound* Sound::get_handle()
+{
+ return this;
+}
+
+Mixer::Mixer()
+{
+ device=-1;
+ name=get_device("DINGUXGDK_MIXER",MIXER_DEVICE);
+ dummy=false;
+ minimum=15;
+ maximum=255;
+ current=minimum;
+}
+
+Mixer::~Mixer()
+{
+ if (device!=-1) close(device);
+}
+
+void Mixer::open_device()
+{
+ int level;
+ device=open(name,O_RDWR);
+ if (device==-1)
+ {
+  Halt("Can't get access to mixer");
+ }
+ dummy=check_file(device);
+ if (dummy==false)
+ {
+  if (ioctl(device,SOUND_MIXER_READ_VOLUME,&level)==-1) dummy=(errno==ENOTTY);
+ }
+
+}
+
+void Mixer::set_level(const int level)
+{
+ if (dummy==false)
+ {
+  if (ioctl(device,SOUND_MIXER_WRITE_VOLUME,&level)==-1)
+  {
+   Halt("Can't set volume");
+  }
+
+ }
+
+}
+
+int Mixer::correct_level(const int level) const
+{
+ int value;
+ value=level;
+ if (value<minimum) value=minimum;
+ if (value>maximum) value=maximum;
+ return value;
+}
+
+void Mixer::set_volume(const int level)
+{
+ current=(this->correct_level(level)<<8)+this->correct_level(level);
+ this->set_level(current);
+}
+
+void Mixer::turn_on()
+{
+ this->set_volume(current);
+}
+
+void Mixer::turn_off()
+{
+ this->set_level(0);
+}
+
+void Mixer::set_device(const char *target)
+{
+ if (device==-1)
+ {
+  name=target;
+ }
+ else
+ {
+  Halt("Can't change device after it was opened");
+ }
+
+}
+
+void Mixer::initialize()
+{
+ this->open_device();
+ this->set_level(current);
+}
+
+int Mixer::get_minimum() const
+{
+ return minimum;
+}
+
+int Mixer::get_maximum() const
+{
+ return maximum;
+}
+
+int Mixer::get_volume() const
+{
+ return current;
+}
+
+Backlight::Backlight()
+{
+ device=NULL;
+ name=get_device("DINGUXGDK_BACKLIGHT",BACKLIGHT_DEVICE);
+ minimum=10;
+ maximum=90;
+ current=minimum;
+ memset(buffer,0,4);
+}
+
+Backlight::~Backlight()
+{
+
+}
+
+void Backlight::open_device(const char *mode)
+{
+ device=fopen(name,mode);
+ if (device==NULL)
+ {
+  Halt("Can't get access to display backlight");
+ }
+
+}
+
+void Backlight::open_read()
+{
+ this->open_device("rt");
+}
+
+void Backlight::open_write()
+{
+ this->open_device("wt");
+}
+
+void Backlight::close_device()
+{
+ if (device!=NULL)
+ {
+  fclose(device);
+  device=NULL;
+ }
+
+}
+
+void Backlight::read_value()
+{
+ memset(buffer,0,4);
+ fgets(buffer,4,device);
+ current=atoi(buffer);
+}
+
+void Backlight::write_value(const unsigned char value)
+{
+ memset(buffer,0,4);
+ sprintf(buffer,"%hhu",value);
+ rewind(device);
+ fputs(buffer,device);
+}
+
+void Backlight::set_level(const unsigned char level)
+{
+ this->open_write();
+ this->write_value(level);
+ this->close_device();
+}
+
+unsigned char Backlight::correct_level(const unsigned char level) const
+{
+ unsigned char value;
+ value=level;
+ if (value>maximum) value=maximum;
+ if (value<minimum) value=minimum;
+ return value;
+}
+
+void Backlight::set_device(const char *target)
+{
+ if (device==NULL)
+ {
+  name=target;
+ }
+ else
+ {
+  Halt("Can't change device after it was opened");
+ }
+
+}
+
+unsigned char Backlight::get_minimum() const
+{
+ return minimum;
+}
+
+unsigned char Backlight::get_maximum() const
+{
+ return maximum;
+}
+
+unsigned char Backlight::get_level()
+{
+ this->open_read();
+ this->read_value();
+ this->close_device();
+ return current;
+}
+
+void Backlight::set_light(const unsigned char level)
+{
+ this->set_level(this->correct_level(level));
+}
+
+void Backlight::increase_level()
+{
+ if (this->get_level()<maximum)
+ {
+  current+=minimum;
+  this->set_light(current);
+ }
+
+}
+
+void Backlight::decrease_level()
+{
+ if (this->get_level()>minimum)
+ {
+  current-=minimum;
+  this->set_light(current);
+ }
+
+}
+
+void Backlight::turn_off()
+{
+ this->get_level();
+ this->set_level(0);
+}
+
+void Backlight::turn_on()
+{
+ this->set_light(current);
+}
+
+System::System()
+{
+ srand(UINT_MAX);
+}
+
+System::~System()
+{
+
+}
+
+unsigned long int System::get_random(const unsigned long int number)
+{
+ return rand()%number;
+}
+
+void System::quit()
+{
+ exit(EXIT_SUCCESS);
+}
+
+void System::run(const char *command)
+{
+ system(command);
+}
+
+char* System::read_environment(const char *variable)
+{
+ return getenv(variable);
+}
+
+void System::enable_logging(const char *name)
+{
+ if (freopen(name,"wt",stdout)==NULL)
+ {
+  Halt("Can't create log file");
+ }
+
+}
+
+Filesystem::Filesystem()
+{
+
+}
+
+Filesystem::~Filesystem()
+{
+
+}
+
+bool Filesystem::file_exist(const char *name)
+{
+ FILE *target;
+ bool exist;
+ exist=false;
+ target=fopen(name,"rb");
+ if (target!=NULL)
+ {
+  exist=true;
+  fclose(target);
+ }
+ return exist;
+}
+
+bool Filesystem::delete_file(const char *name)
+{
+ return remove(name)==0;
+}
+
+Binary_File::Binary_File()
+{
+ target=NULL;
+}
+
+Binary_File::~Binary_File()
+{
+ if (target!=NULL)
+ {
+  fclose(target);
+  target=NULL;
+ }
+
+}
+
+void Binary_File::open_file(const char *name,const char *mode)
+{
+ target=fopen(name,mode);
+ if (target==NULL)
+ {
+  Halt("Can't open the binary file");
+ }
+
+}
+
+void Binary_File::close()
+{
+ if (target!=NULL)
+ {
+  fclose(target);
+  target=NULL;
+ }
+
+}
+
+void Binary_File::set_position(const long int offset)
+{
+ fseek(target,offset,SEEK_SET);
+}
+
+long int Binary_File::get_position()
+{
+ return ftell(target);
+}
+
+long int Binary_File::get_length()
+{
+ long int result;
+ fseek(target,0,SEEK_END);
+ result=ftell(target);
+ rewind(target);
+ return result;
+}
+
+bool Binary_File::check_error()
+{
+ return ferror(target)!=0;
+}
+
+Input_File::Input_File()
+{
+
+}
+
+Input_File::~Input_File()
+{
+
+}
+
+void Input_File::open(const char *name)
+{
+ this->close();
+ this->open_file(name,"rb");
+}
+
+void Input_File::read(void *buffer,const size_t length)
+{
+ fread(buffer,sizeof(char),length,target);
+}
+
+Output_File::Output_File()
+{
+
+}
+
+Output_File::~Output_File()
+{
+
+}
+
+void Output_File::open(const char *name)
+{
+ this->close();
+ this->open_file(name,"wb");
+}
+
+void Output_File::create_temp()
+{
+ this->close();
+ target=tmpfile();
+ if (target==NULL)
+ {
+  Halt("Can't create a temporary file");
+ }
+
+}
+
+void Output_File::write(void *buffer,const size_t length)
+{
+ fwrite(buffer,sizeof(char),length,target);
+}
+
+void Output_File::flush()
+{
+ fflush(target);
+}
+
+Audio::Audio()
+{
+ memset(&head,0,44);
+}
+
+Audio::~Audio()
+{
+
+}
+
+void Audio::read_head()
+{
+ target.read(&head,44);
+}
+
+void Audio::check_riff_signature()
+{
+ if (strncmp(head.riff_signature,"RIFF",4)!=0)
+ {
+  Halt("Incorrect riff signature");
+ }
+
+}
+
+void Audio::check_wave_signature()
+{
+ if (strncmp(head.wave_signature,"WAVE",4)!=0)
+ {
+  Halt("Incorrect wave signature");
+ }
+
+}
+
+void Audio::check_type() const
+{
+ if (head.type!=1)
+ {
+  Halt("Incorrect type of wave file");
+ }
+
+}
+
+void Audio::check_bits() const
+{
+ if (head.bits!=16)
+ {
+  Halt("Incorrect amount of sound bits");
+ }
+
+}
+
+void Audio::check_channels() const
+{
+ if ((head.channels==0)||(head.channels>2))
+ {
+  Halt("Incorrect number of audio channels");
+ }
+
+}
+
+void Audio::check_wave()
+{
+ this->check_riff_signature();
+ this->check_wave_signature();
+ this->check_type();
+ this->check_bits();
+ this->check_channels();
+}
+
+Audio* Audio::get_handle()
+{
+ return this;
+}
+
+size_t Audio::get_total() const
+{
+ return static_cast<size_t>(head.date_length);
+}
+
+size_t Audio::get_block() const
+{
+ return static_cast<size_t>(head.block_length);
+}
+
+unsigned long int Audio::get_rate() const
+{
+ return head.rate;
+}
+
+unsigned short int Audio::get_channels() const
+{
+ return head.channels;
+}
+
+unsigned short int Audio::get_bits() const
+{
+ return head.bits;
+}
+
+void Audio::load_wave(const char *name)
+{
+ target.open(name);
+ this->read_head();
+ this->check_wave();
+}
+
+void Audio::read_data(void *buffer,const size_t length)
+{
+ target.read(buffer,length);
+}
+
+void Audio::go_start()
+{
+ target.set_position(44);
+}
+
+Player::Player()
+{
+ sound=NULL;
+ target=NULL;
+ buffer=NULL;
+ index=0;
+ length=0;
+}
+
+Player::~Player()
+{
+ if (buffer!=NULL) delete[] buffer;
+}
+
+void Player::configure_player(Audio *audio)
+{
+ index=0;
+ target=audio;
+ length=target->get_total();
+}
+
+void Player::clear_buffer()
+{
+ if (buffer!=NULL)
+ {
+  delete[] buffer;
+  buffer=NULL;
+ }
+
+}
+
+void Player::create_buffer()
+{
+ try
+ {
+  buffer=new char[sound->get_length()];
+ }
+ catch (...)
+ {
+  Halt("Can't allocate memory for audio buffer");
+ }
+
+}
+
+void Player::rewind_audio()
+{
+ index=0;
+ target->go_start();
+}
+
+bool Player::is_end() const
+{
+ bool end_audio;
+ end_audio=false;
+ if (index==length)
+ {
+  end_audio=true;
+ }
+ return end_audio;
+}
+
+void Player::load(Audio *audio)
+{
+ this->configure_player(audio);
+ this->clear_buffer();
+ this->create_buffer();
+}
+
+void Player::initialize(Sound *target)
+{
+ sound=target;
+}
+
+void Player::play()
+{
+ size_t block;
+ size_t elapsed;
+ block=sound->get_length();
+ if (index<length)
+ {
+  if (sound->check_busy()==false)
+  {
+   elapsed=length-index;
+   if (block>elapsed) block=elapsed;
+   target->read_data(buffer,block);
+   index+=sound->send(buffer,block);
+  }
+
+ }
+
+}
+
+void Player::loop()
+{
+ if (this->is_end())
+ {
+  this->rewind_audio();
+ }
+ else
+ {
+  this->play();
+ }
+
+}
+
+Primitive::Primitive()
+{
+ surface=NULL;
+ color.red=0;
+ color.green=0;
+ color.blue=0;
+}
+
+Primitive::~Primitive()
+{
+
+}
+
+void Primitive::initialize(Screen *screen)
+{
+ surface=screen;
+}
+
+void Primitive::set_color(const unsigned char red,const unsigned char green,const unsigned char blue)
+{
+ color.red=red;
+ color.green=green;
+ color.blue=blue;
+}
+
+void Primitive::draw_line(const unsigned long int x1,const unsigned long int y1,const unsigned long int x2,const unsigned long int y2)
+{
+ unsigned long int delta_x,delta_y,index,steps;
+ float x,y,shift_x,shift_y;
+ if (x1>x2)
+ {
+  delta_x=x1-x2;
+ }
+ else
+ {
+  delta_x=x2-x1;
+ }
+ if (y1>y2)
+ {
+  delta_y=y1-y2;
+ }
+ else
+ {
+  delta_y=y2-y1;
+ }
+ steps=delta_x;
+ if (steps<delta_y) steps=delta_y;
+ x=x1;
+ y=y1;
+ shift_x=static_cast<float>(delta_x)/static_cast<float>(steps);
+ shift_y=static_cast<float>(delta_y)/static_cast<float>(steps);
+ for (index=steps;index>0;--index)
+ {
+  x+=shift_x;
+  y+=shift_y;
+  surface->draw_pixel(x,y,color.red,color.green,color.blue);
+ }
+
+}
+
+void Primitive::draw_rectangle(const unsigned long int x,const unsigned long int y,const unsigned long int width,const unsigned long int height)
+{
+ unsigned long int stop_x,stop_y;
+ stop_x=x+width;
+ stop_y=y+height;
+ this->draw_line(x,y,stop_x,y);
+ this->draw_line(x,stop_y,stop_x,stop_y);
+ this->draw_line(x,y,x,stop_y);
+ this->draw_line(stop_x,y,stop_x,stop_y);
+}
+
+void Primitive::draw_filled_rectangle(const unsigned long int x,const unsigned long int y,const unsigned long int width,const unsigned long int height)
+{
+ surface->fill_rectangle(x,y,width,height,pack_pixel(color.red,color.green,color.blue));
+}
+
+Image::Image()
+{
+ width=0;
+ height=0;
+ data=NULL;
+ alpha=NULL;
+}
+
+Image::~Image()
+{
+ if (data!=NULL)
+ {
+  delete[] data;
+  data=NULL;
+ }
+ if (alpha!=NULL)
+ {
+  delete[] alpha;
+  alpha=NULL;
+ }
+
+}
+
+unsigned char *Image::create_buffer(const size_t length)
+{
+ unsigned char *result;
+ result=NULL;
+ try
+ {
+  result=new unsigned char[length];
+ }
+ catch (...)
+ {
+  Halt("Can't allocate memory for image buffer");
+ }
+ return result;
+}
+
+void Image::clear_buffer()
+{
+ if (data!=NULL)
+ {
+  delete[] data;
+  data=NULL;
+ }
+ if (alpha!=NULL)
+ {
+  delete[] alpha;
+  alpha=NULL;
+ }
+
+}
+
+void Image::split_alpha(const unsigned char *source)
+{
+ size_t index,amount;
+ amount=static_cast<size_t>(width)*static_cast<size_t>(height);
+ data=this->create_buffer(this->get_length());
+ alpha=this->create_buffer(amount);
+ for (index=0;index<amount;++index)
+ {
+  data[3*index]=source[4*index];
+  data[3*index+1]=source[4*index+1];
+  data[3*index+2]=source[4*index+2];
+  alpha[index]=source[4*index+3];
+ }
+
+}
+
+void Image::load_tga(const char *name)
+{
+ Input_File target;
+ size_t index,position,amount,depth,compressed_length,uncompressed_length;
+ unsigned char *compressed;
+ unsigned char *uncompressed;
+ TGA_head head;
+ TGA_map color_map;
+ TGA_image image;
+ this->clear_buffer();
+ target.open(name);
+ compressed_length=static_cast<size_t>(target.get_length()-18);
+ target.read(&head,3);
+ target.read(&color_map,5);
+ target.read(&image,10);
+ if ((head.color_map!=0)||((image.color!=24)&&(image.color!=32)))
+ {
+  Halt("Invalid image format");
+ }
+ if (head.type!=2)
+ {
+  if (head.type!=10)
+  {
+   Halt("Invalid image format");
+  }
+
+ }
+ index=0;
+ position=0;
+ width=image.width;
+ height=image.height;
+ depth=image.color/CHAR_BIT;
+ uncompressed_length=static_cast<size_t>(width)*static_cast<size_t>(height)*depth;
+ uncompressed=this->create_buffer(uncompressed_length);
+ if (head.type==2)
+ {
+  target.read(uncompressed,uncompressed_length);
+ }
+ if (head.type==10)
+ {
+  compressed=this->create_buffer(compressed_length);
+  target.read(compressed,compressed_length);
+  while(index<uncompressed_length)
+  {
+   if (compressed[position]<128)
+   {
+    amount=compressed[position]+1;
+    amount*=depth;
+    memmove(uncompressed+index,compressed+(position+1),amount);
+    index+=amount;
+    position+=1+amount;
+   }
+   else
+   {
+    for (amount=compressed[position]-127;amount>0;--amount)
+    {
+     memmove(uncompressed+index,compressed+(position+1),depth);
+     index+=depth;
+    }
+    position+=1+depth;
+   }
+
+  }
+  delete[] compressed;
+ }
+ target.close();
+ if (depth==4)
+ {
+  this->split_alpha(uncompressed);
+  delete[] uncompressed;
+ }
+ else
+ {
+  data=uncompressed;
+ }
+
+}
+
+void Image::load_pcx(const char *name)
+{
+ Input_File target;
+ unsigned long int x,y;
+ size_t index,position,line,row,length,uncompressed_length;
+ unsigned char repeat;
+ unsigned char *original;
+ unsigned char *uncompressed;
+ PCX_head head;
+ this->clear_buffer();
+ target.open(name);
+ length=static_cast<size_t>(target.get_length()-128);
+ target.read(&head,128);
+ if ((head.color*head.planes!=24)&&(head.compress!=1))
+ {
+  Halt("Incorrect image format");
+ }
+ width=head.max_x-head.min_x+1;
+ height=head.max_y-head.min_y+1;
+ row=static_cast<size_t>(width)*3;
+ line=static_cast<size_t>(head.planes)*static_cast<size_t>(head.plane_length);
+ uncompressed_length=row*height;
+ index=0;
+ position=0;
+ original=this->create_buffer(length);
+ uncompressed=this->create_buffer(uncompressed_length);
+ target.read(original,length);
+ target.close();
+ while (index<length)
+ {
+  if (original[index]<192)
+  {
+   uncompressed[position]=original[index];
+   ++position;
+   ++index;
+  }
+  else
+  {
+   for (repeat=original[index]-192;repeat>0;--repeat)
+   {
+    uncompressed[position]=original[index+1];
+    ++position;
+   }
+   index+=2;
+  }
+
+ }
+ delete[] original;
+ original=this->create_buffer(uncompressed_length);
+ for (x=0;x<width;++x)
+ {
+  for (y=0;y<height;++y)
+  {
+   index=static_cast<size_t>(x)*3+static_cast<size_t>(y)*row;
+   position=static_cast<size_t>(x)+static_cast<size_t>(y)*line;
+   original[index]=uncompressed[position+2*static_cast<size_t>(head.plane_length)];
+   original[index+1]=uncompressed[position+static_cast<size_t>(head.plane_length)];
+   original[index+2]=uncompressed[position];
+  }
+
+ }
+ delete[] uncompressed;
+ data=original;
+}
+
+unsigned long int Image::get_width() const
+{
+ return width;
+}
+
+unsigned long int Image::get_height() const
+{
+ return height;
+}
+
+size_t Image::get_length() const
+{
+ return static_cast<size_t>(width)*static_cast<size_t>(height)*3;
+}
+
+unsigned char *Image::get_data()
+{
+ return data;
+}
+
+unsigned char *Image::get_alpha()
+{
+ return alpha;
+}
+
+void Image::destroy_image()
+{
+ width=0;
+ height=0;
+ this->clear_buffer();
+}
+
+Image_Storage::Image_Storage()
+{
+ image=NULL;
+ alpha=NULL;
+ references=1;
+}
+
+Image_Storage::~Image_Storage()
+{
+ if (image!=NULL)
+ {
+  free(image);
+  image=NULL;
+ }
+ if (alpha!=NULL)
+ {
+  free(alpha);
+  alpha=NULL;
+ }
+
+}
+
+void Image_Storage::set_image(unsigned short int *buffer,unsigned char *mask)
+{
+ image=buffer;
+ alpha=mask;
+}
+
+void Image_Storage::acquire()
+{
+ ++references;
+}
+
+bool Image_Storage::release()
+{
+ --references;
+ return references==0;
+}
+
+unsigned long int Image_Storage::get_references() const
+{
+ return references;
+}
+
+Surface::Surface()
+{
+ width=0;
+ height=0;
+ stride=0;
+ revision=0;
+ exposed=false;
+ storage=NULL;
+ image=NULL;
+ alpha=NULL;
+ surface=NULL;
+}
+
+Surface::~Surface()
+{
+ surface=NULL;
+ this->release_storage();
+}
+
+void Surface::release_storage()
+{
+ if (storage!=NULL)
+ {
+  if (storage->release()==true) delete storage;
+  storage=NULL;
+ }
+ image=NULL;
+ alpha=NULL;
+}
+
+void Surface::unshare_image()
+{
+ unsigned long int y;
+ size_t row,source,target;
+ unsigned short int *copy;
+ unsigned char *mask;
+ if (storage!=NULL)
+ {
+  if ((storage->get_references()>1)||(stride!=width))
+  {
+   row=static_cast<size_t>(width);
+   copy=this->create_buffer(width,height);
+   mask=NULL;
+   if (alpha!=NULL) mask=this->create_alpha(width,height);
+   for (y=0;y<height;++y)
+   {
+    source=this->get_offset(0,0,y);
+    target=this->get_offset(0,0,y,width);
+    memmove(copy+target,image+source,row*sizeof(unsigned short int));
+    if (alpha!=NULL) memmove(mask+target,alpha+source,row);
+   }
+   this->set_buffer(copy,mask);
+  }
+
+ }
+
+}
+
+unsigned short int *Surface::create_buffer(const unsigned long int image_width,const unsigned long int image_height)
+{
+ unsigned short int *result;
+ size_t length;
+ length=static_cast<size_t>(image_width)*static_cast<size_t>(image_height);
+ result=static_cast<unsigned short int*>(calloc(length,sizeof(unsigned short int)));
+ if (result==NULL)
+ {
+  Halt("Can't allocate memory for image buffer");
+ }
+ return result;
+}
+
+unsigned char *Surface::create_alpha(const unsigned long int image_width,const unsigned long int image_height)
+{
+ unsigned char *result;
+ size_t length;
+ length=static_cast<size_t>(image_width)*static_cast<size_t>(image_height);
+ result=static_cast<unsigned char*>(calloc(length,sizeof(unsigned char)));
+ if (result==NULL)
+ {
+  Halt("Can't allocate memory for alpha buffer");
+ }
+ return result;
+}
+
+unsigned short int *Surface::pack_image(Image &buffer)
+{
+ size_t index,position,length;
+ unsigned char *data;
+ unsigned short int *result;
+ result=this->create_buffer(buffer.get_width(),buffer.get_height());
+ length=static_cast<size_t>(buffer.get_width())*static_cast<size_t>(buffer.get_height());
+ data=buffer.get_data();
+ position=0;
+ for (index=0;index<length;++index)
+ {
+  result[index]=pack_pixel(data[position+2],data[position+1],data[position]);
+  position+=3;
+ }
+ return result;
+}
+
+unsigned char *Surface::copy_alpha(Image &buffer)
+{
+ unsigned char *result;
+ result=NULL;
+ if (buffer.get_alpha()!=NULL)
+ {
+  result=this->create_alpha(buffer.get_width(),buffer.get_height());
+  memmove(result,buffer.get_alpha(),static_cast<size_t>(buffer.get_width())*static_cast<size_t>(buffer.get_height()));
+ }
+ return result;
+}
+
+void Surface::save()
+{
+ surface->save();
+}
+
+void Surface::restore()
+{
+ surface->restore();
+}
+
+void Surface::restore(const unsigned short int *source)
+{
+ surface->restore(source);
+}
+
+void Surface::detach_shadow(const unsigned short int *source)
+{
+ if (surface!=NULL) surface->detach_shadow(source);
+}
+
+void Surface::invalidate(const unsigned long int x,const unsigned long int y,const unsigned long int width,const unsigned long int height)
+{
+ surface->invalidate(x,y,width,height);
+}
+
+void Surface::clear_buffer()
+{
+ this->release_storage();
+}
+
+void Surface::set_size(const unsigned long int image_width,const unsigned long int image_height)
+{
+ width=image_width;
+ height=image_height;
+}
+
+void Surface::set_buffer(unsigned short int *buffer,unsigned char *mask)
+{
+ Image_Storage *target;
+ target=NULL;
+ try
+ {
+  target=new Image_Storage;
+ }
+ catch (...)
+ {
+  Halt("Can't allocate memory for image storage");
+ }
+ target->set_image(buffer,mask);
+ this->release_storage();
+ storage=target;
+ image=buffer;
+ alpha=mask;
+ stride=width;
+ exposed=false;
+ ++revision;
+}
+
+void Surface::share_image(const Surface &target)
+{
+ if (storage!=target.storage)
+ {
+  this->release_storage();
+  storage=target.storage;
+  if (storage!=NULL) storage->acquire();
+  image=target.image;
+  alpha=target.alpha;
+ }
+ width=target.width;
+ height=target.height;
+ stride=target.stride;
+ exposed=false;
+ ++revision;
+ if (target.exposed==true) this->unshare_image();
+}
+
+void Surface::share_region(const Surface &target,const Atlas_Region &region)
+{
+ size_t offset;
+ if (storage!=target.storage)
+ {
+  this->release_storage();
+  storage=target.storage;
+  if (storage!=NULL) storage->acquire();
+ }
+ offset=target.get_offset(0,region.x,region.y);
+ image=target.image+offset;
+ alpha=NULL;
+ if ((region.translucent==true)&&(target.alpha!=NULL)) alpha=target.alpha+offset;
+ width=region.width;
+ height=region.height;
+ stride=target.stride;
+ exposed=false;
+ ++revision;
+ if (target.exposed==true) this->unshare_image();
+}
+
+void Surface::repack_image(const size_t *offsets,const unsigned long int amount,const unsigned long int frame_width,const unsigned long int frame_height)
+{
+ unsigned long int index,y;
+ size_t row,source,target;
+ unsigned short int *packed;
+ unsigned char *mask;
+ row=static_cast<size_t>(frame_width);
+ packed=this->create_buffer(frame_width,frame_height*amount);
+ mask=NULL;
+ if (alpha!=NULL) mask=this->create_alpha(frame_width,frame_height*amount);
+ target=0;
+ for (index=0;index<amount;++index)
+ {
+  source=offsets[index];
+  for (y=0;y<frame_height;++y)
+  {
+   memmove(packed+target,image+source,row*sizeof(unsigned short int));
+   if (alpha!=NULL) memmove(mask+target,alpha+source,row);
+   source+=static_cast<size_t>(stride);
+   target+=row;
+  }
+
+ }
+ width=frame_width;
+ height=frame_height*amount;
+ this->set_buffer(packed,mask);
+}
+
+const unsigned short int *Surface::read_image() const
+{
+ return image;
+}
+
+const unsigned char *Surface::read_alpha() const
+{
+ return alpha;
+}
+
+size_t Surface::get_offset(const unsigned long int start,const unsigned long int x,const unsigned long int y,const unsigned long int target_width)
+{
+ return static_cast<size_t>(start)+static_cast<size_t>(x)+static_cast<size_t>(y)*static_cast<size_t>(target_width);
+}
+
+size_t Surface::get_offset(const unsigned long int start,const unsigned long int x,const unsigned long int y) const
+{
+ return static_cast<size_t>(start)+static_cast<size_t>(x)+static_cast<size_t>(y)*static_cast<size_t>(stride);
+}
+
+void Surface::draw_image_pixel(const size_t offset,const unsigned long int x,const unsigned long int y)
+{
+ surface->draw_pixel(x,y,image[offset]);
+}
+
+void Surface::draw_image_region(const size_t offset,const unsigned long int x,const unsigned long int y,const unsigned long int region_width,const unsigned long int region_height,const bool horizontal,const bool vertical)
+{
+ surface->draw_image(x,y,region_width,region_height,image+offset,stride,horizontal,vertical);
+}
+
+void Surface::draw_image_runs(const size_t offset,const unsigned long int x,const unsigned long int y,const unsigned long int region_width,const unsigned long int region_height,const Opaque_Runs &runs,const size_t row,const unsigned long int origin,const bool horizontal,const bool vertical)
+{
+ surface->draw_runs(x,y,region_width,region_height,image+offset,stride,runs,row,origin,horizontal,vertical);
+}
+
+void Surface::draw_scrolled_image(const size_t offset,const unsigned long int region_width,const unsigned long int region_height,const unsigned long int scroll_x,const unsigned long int scroll_y,const bool horizontal_wrap,const bool vertical_wrap,const bool horizontal,const bool vertical)
+{
+ surface->draw_scrolled(region_width,region_height,image+offset,stride,scroll_x,scroll_y,horizontal_wrap,vertical_wrap,horizontal,vertical);
+}
+
+void Surface::draw_scrolled_runs(const size_t offset,const unsigned long int region_width,const unsigned long int region_height,const Opaque_Runs &runs,const size_t row,const unsigned long int scroll_x,const unsigned long int scroll_y,const bool horizontal_wrap,const bool vertical_wrap,const bool horizontal,const bool vertical)
+{
+ surface->draw_scrolled_runs(region_width,region_height,image+offset,stride,runs,row,scroll_x,scroll_y,horizontal_wrap,vertical_wrap,horizontal,vertical);
+}
+
+void Surface::draw_transformed_image(const size_t offset,const unsigned long int x,const unsigned long int y,const unsigned long int region_width,const unsigned long int region_height,const double angle,const double scale,const bool keyed,const unsigned short int key,const bool horizontal,const bool vertical)
+{
+ const unsigned char *source;
+ source=NULL;
+ if (alpha!=NULL) source=alpha+offset;
+ surface->draw_affine(x,y,region_width,region_height,image+offset,source,stride,angle,scale,keyed,key,horizontal,vertical);
+}
+
+void Surface::draw_blended_image(const size_t offset,const unsigned long int x,const unsigned long int y,const unsigned long int region_width,const unsigned long int region_height,const Opaque_Runs &runs,const size_t row,const unsigned long int origin,const unsigned char opacity,const bool horizontal,const bool vertical)
+{
+ const unsigned char *source;
+ source=NULL;
+ if (alpha!=NULL) source=alpha+offset;
+ surface->draw_blended_runs(x,y,region_width,region_height,image+offset,source,stride,runs,row,origin,opacity,horizontal,vertical);
+}
+
+unsigned long int Surface::get_surface_width() const
+{
+ return surface->get_frame_width();
+}
+
+unsigned long int Surface::get_surface_height() const
+{
+ return surface->get_frame_height();
+}
+
+unsigned long int Surface::get_stride() const
+{
+ return stride;
+}
+
+unsigned long int Surface::get_revision() const
+{
+ return revision;
+}
+
+unsigned long int Surface::get_saves() const
+{
+ return surface->get_saves();
+}
+
+void Surface::initialize(Screen *screen)
+{
+ surface=screen;
+}
+
+size_t Surface::get_length() const
+{
+ size_t length;
+ length=0;
+ if ((width>0)&&(height>0)) length=this->get_offset(0,width,height-1)*sizeof(unsigned short int);
+ return length;
+}
+
+unsigned short int *Surface::get_image()
+{
+ this->unshare_image();
+ exposed=true;
+ ++revision;
+ return image;
+}
+
+unsigned char *Surface::get_alpha()
+{
+ this->unshare_image();
+ exposed=true;
+ ++revision;
+ return alpha;
+}
+
+void Surface::release_image()
+{
+ exposed=false;
+ ++revision;
+}
+
+unsigned long int Surface::get_references() const
+{
+ unsigned long int amount;
+ amount=0;
+ if (storage!=NULL) amount=storage->get_references();
+ return amount;
+}
+
+void Surface::load_image(Image &buffer)
+{
+ width=buffer.get_width();
+ height=buffer.get_height();
+ this->clear_buffer();
+ this->set_buffer(this->pack_image(buffer),this->copy_alpha(buffer));
+}
+
+void Surface::load_image(Atlas &atlas,const unsigned long int index)
+{
+ this->share_region(atlas,atlas.get_region(index));
+}
+
+unsigned long int Surface::get_image_width() const
+{
+ return width;
+}
+
+unsigned long int Surface::get_image_height() const
+{
+ return height;
+}
+
+void Surface::mirror_image(const MIRROR_TYPE kind)
+{
+ unsigned long int x,y,index;
+ unsigned short int *mirrored_image;
+ unsigned char *mirrored_alpha;
+ x=0;
+ y=0;
+ mirrored_image=this->create_buffer(width,height);
+ mirrored_alpha=NULL;
+ if (alpha!=NULL) mirrored_alpha=this->create_alpha(width,height);
+ if (kind==MIRROR_HORIZONTAL)
+ {
+  for (index=width*height;index>0;--index)
+  {
+   mirrored_image[this->get_offset(0,x,y,width)]=image[this->get_offset(0,(width-x-1),y)];
+   if (alpha!=NULL) mirrored_alpha[this->get_offset(0,x,y,width)]=alpha[this->get_offset(0,(width-x-1),y)];
+   ++x;
+   if (x==width)
    {
-    amount=compressed[position]+1;
-    amount*=3;
-    memmove(uncompressed+index,compressed+(position+1),amount);
-    index+=amount;
-    position+=1+amount;
+    x=0;
+    ++y;
    }
-   else
+
+  }
+
+ }
+ if (kind==MIRROR_VERTICAL)
+ {
+  for (index=width*height;index>0;--index )
+  {
+   mirrored_image[this->get_offset(0,x,y,width)]=image[this->get_offset(0,x,(height-y-1))];
+   if (alpha!=NULL) mirrored_alpha[this->get_offset(0,x,y,width)]=alpha[this->get_offset(0,x,(height-y-1))];
+   ++x;
+   if (x==width)
    {
-    for (amount=compressed[position]-127;amount>0;--amount)
-    {
-     memmove(uncompressed+index,compressed+(position+1),3);
-     index+=3;
-    }
-    position+=4;
+    x=0;
+    ++y;
    }
 
   }
-  delete[] compressed;
+
  }
- target.close();
- data=uncompressed;
+ this->set_buffer(mirrored_image,mirrored_alpha);
+}
+
+void Surface::resize_image(const unsigned long int new_width,const unsigned long int new_height)
+{
+ float x_ratio,y_ratio;
+ unsigned long int x,y,steps;
+ size_t index,location,position;
+ unsigned short int *scaled_image;
+ unsigned char *scaled_alpha;
+ x=0;
+ y=0;
+ steps=new_width*new_height;
+ scaled_image=this->create_buffer(new_width,new_height);
+ scaled_alpha=NULL;
+ if (alpha!=NULL) scaled_alpha=this->create_alpha(new_width,new_height);
+ x_ratio=static_cast<float>(width)/static_cast<float>(new_width);
+ y_ratio=static_cast<float>(height)/static_cast<float>(new_height);
+ for (index=0;index<steps;++index)
+ {
+  location=this->get_offset(0,x,y,new_width);
+  position=this->get_offset(0,(x_ratio*static_cast<float>(x)),(y_ratio*static_cast<float>(y)),stride);
+  scaled_image[location]=image[position];
+  if (alpha!=NULL) scaled_alpha[location]=alpha[position];
+  ++x;
+  if (x==new_width)
+  {
+   x=0;
+   ++y;
+  }
+
+ }
+ width=new_width;
+ height=new_height;
+ this->set_buffer(scaled_image,scaled_alpha);
+}
+
+void Surface::horizontal_mirror()
+{
+ this->mirror_image(MIRROR_HORIZONTAL);
+}
+
+void Surface::vertical_mirror()
+{
+ this->mirror_image(MIRROR_VERTICAL);
+}
+
+Animation::Animation()
+{
+ start=0;
+ frame=1;
+ frames=1;
+ amount=0;
+ table=NULL;
+ grid_columns=1;
+ grid_rows=1;
+}
+
+Animation::~Animation()
+{
+ this->destroy_table();
+}
+
+void Animation::destroy_table()
+{
+ if (table!=NULL)
+ {
+  delete[] table;
+  table=NULL;
+ }
+ amount=0;
+}
+
+void Animation::update_start()
+{
+ start=0;
+ if (amount>0) start=table[this->get_position()];
+}
+
+void Animation::set_frame(const unsigned long int target)
+{
+ if (target>0)
+ {
+  if (target<=frames) frame=target;
+ }
+ this->update_start();
+}
+
+void Animation::increase_frame()
+{
+ ++frame;
+ if (frame>frames)
+ {
+  frame=1;
+ }
+ this->update_start();
+}
+
+void Animation::create_table(const unsigned long int columns,const unsigned long int rows,const unsigned long int frame_width,const unsigned long int frame_height,const unsigned long int stride)
+{
+ unsigned long int index;
+ this->destroy_table();
+ try
+ {
+  table=new size_t[columns*rows];
+ }
+ catch (...)
+ {
+  Halt("Can't allocate memory for frame table");
+ }
+ amount=columns*rows;
+ for (index=0;index<amount;++index)
+ {
+  table[index]=static_cast<size_t>(index%columns)*static_cast<size_t>(frame_width)+static_cast<size_t>(index/columns)*static_cast<size_t>(frame_height)*static_cast<size_t>(stride);
+ }
+ this->update_start();
+}
+
+unsigned long int Animation::get_table_size() const
+{
+ return amount;
+}
+
+unsigned long int Animation::get_position() const
+{
+ unsigned long int position;
+ position=0;
+ if (frame<=amount) position=frame-1;
+ return position;
+}
+
+size_t Animation::get_frame_offset(const unsigned long int index) const
+{
+ return table[index];
+}
+
+const size_t *Animation::get_frame_table() const
+{
+ return table;
+}
+
+void Animation::set_frames(const unsigned long int amount)
+{
+ if (amount>1) frames=amount;
+}
+
+unsigned long int Animation::get_frames() const
+{
+ return frames;
+}
+
+unsigned long int Animation::get_frame() const
+{
+ return frame;
+}
+
+Background::Background()
+{
+ background_width=0;
+ background_height=0;
+ maximum_width=0;
+ maximum_height=0;
+ current=0;
+ scroll_x=0;
+ scroll_y=0;
+ current_kind=NORMAL_BACKGROUND;
+ horizontal_flip=false;
+ vertical_flip=false;
+ horizontal_wrap=false;
+ vertical_wrap=false;
+ transparent=false;
+ encoded=false;
+ custom_key=false;
+ key=0;
+ encoded_key=0;
+ encoded_revision=0;
+ encoded_frames=0;
+ table_revision=0;
+ cache_revision=0;
+ saves=0;
+ cache=NULL;
+ cache_amount=0;
+ cache_used=0;
+ cache_limit=BACKGROUND_CACHE_LIMIT;
+}
+
+Background::~Background()
+{
+ this->destroy_cache();
+}
+
+void Background::resolve_key()
+{
+ if (custom_key==false)
+ {
+  if (this->read_image()!=NULL) key=this->read_image()[0];
+ }
+
 }
 
-void Image::load_pcx(const char *name)
+bool Background::check_runs() const
 {
- Input_File target;
- unsigned long int x,y;
- size_t index,position,line,row,length,uncompressed_length;
- unsigned char repeat;
- unsigned char *original;
- unsigned char *uncompressed;
- PCX_head head;
- this->clear_buffer();
- target.open(name);
- length=static_cast<size_t>(target.get_length()-128);
- target.read(&head,128);
- if ((head.color*head.planes!=24)&&(head.compress!=1))
+ bool valid;
+ valid=false;
+ if (encoded==true)
  {
-  Halt("Incorrect image format");
+  valid=(encoded_revision==this->get_revision())&&(encoded_frames==this->get_table_size())&&(encoded_key==key);
  }
- width=head.max_x-head.min_x+1;
- height=head.max_y-head.min_y+1;
- row=static_cast<size_t>(width)*3;
- line=static_cast<size_t>(head.planes)*static_cast<size_t>(head.plane_length);
- uncompressed_length=row*height;
- index=0;
- position=0;
- original=this->create_buffer(length);
- uncompressed=this->create_buffer(uncompressed_length);
- target.read(original,length);
- target.close();
- while (index<length)
+ return valid;
+}
+
+void Background::encode_runs()
+{
+ unsigned long int target,frames,y;
+ size_t amount;
+ const unsigned short int *source;
+ frames=this->get_table_size();
+ amount=0;
+ for (target=0;target<frames;++target)
  {
-  if (original[index]<192)
+  source=this->read_image()+this->get_frame_offset(target);
+  for (y=0;y<background_height;++y)
   {
-   uncompressed[position]=original[index];
-   ++position;
-   ++index;
-  }
-  else
-  {
-   for (repeat=original[index]-192;repeat>0;--repeat)
-   {
-    uncompressed[position]=original[index+1];
-    ++position;
-   }
-   index+=2;
+   amount+=runs.count_runs(source,NULL,background_width,key,true);
+   source+=this->get_stride();
   }
 
  }
- delete[] original;
- original=this->create_buffer(uncompressed_length);
- for (x=0;x<width;++x)
+ runs.create_runs(static_cast<size_t>(frames)*static_cast<size_t>(background_height),amount);
+ for (target=0;target<frames;++target)
  {
-  for (y=0;y<height;++y)
+  source=this->read_image()+this->get_frame_offset(target);
+  for (y=0;y<background_height;++y)
   {
-   index=static_cast<size_t>(x)*3+static_cast<size_t>(y)*row;
-   position=static_cast<size_t>(x)+static_cast<size_t>(y)*line;
-   original[index]=uncompressed[position+2*static_cast<size_t>(head.plane_length)];
-   original[index+1]=uncompressed[position+static_cast<size_t>(head.plane_length)];
-   original[index+2]=uncompressed[position];
+   runs.add_row(source,NULL,background_width,key,true);
+   source+=this->get_stride();
   }
 
  }
- delete[] uncompressed;
- data=original;
+ encoded=true;
+ encoded_revision=this->get_revision();
+ encoded_frames=frames;
+ encoded_key=key;
 }
 
-unsigned long int Image::get_width() const
+void Background::destroy_cache()
 {
- return width;
+ size_t index;
+ if (cache!=NULL)
+ {
+  for (index=0;index<cache_amount;++index)
+  {
+   if (cache[index]!=NULL)
+   {
+    this->detach_shadow(cache[index]);
+    delete[] cache[index];
+   }
+
+  }
+  delete[] cache;
+  cache=NULL;
+ }
+ cache_amount=0;
+ cache_used=0;
+ current=0;
 }
 
-unsigned long int Image::get_height() const
+void Background::create_cache(const size_t amount)
 {
- return height;
+ size_t index;
+ this->destroy_cache();
+ if (amount>0)
+ {
+  try
+  {
+   cache=new unsigned short int*[amount];
+  }
+  catch (...)
+  {
+   Halt("Can't allocate memory for background cache");
+  }
+  for (index=0;index<amount;++index)
+  {
+   cache[index]=NULL;
+  }
+  cache_amount=amount;
+ }
+ cache_revision=this->get_revision();
 }
 
-size_t Image::get_length() const
+void Background::convert_frame(const unsigned long int index,unsigned short int *target)
 {
- return static_cast<size_t>(width)*static_cast<size_t>(height)*3;
+ unsigned long int line,column,row,width,height;
+ const unsigned short int *source;
+ width=this->get_surface_width();
+ height=this->get_surface_height();
+ for (line=0;line<height;++line)
+ {
+  row=line;
+  if (vertical_flip==true) row=background_height-line-1;
+  source=this->read_image()+this->get_offset(this->get_frame_offset(index),0,row);
+  if (horizontal_flip==true)
+  {
+   source+=background_width-1;
+   for (column=0;column<width;++column)
+   {
+    target[column]=*source;
+    --source;
+   }
+
+  }
+  else
+  {
+   memmove(target,source,static_cast<size_t>(width)*sizeof(unsigned short int));
+  }
+  target+=width;
+ }
+
 }
 
-unsigned char *Image::get_data()
+void Background::fill_cache()
 {
- return data;
+ size_t index,length;
+ length=static_cast<size_t>(this->get_surface_width())*static_cast<size_t>(this->get_surface_height());
+ for (index=0;(index<cache_amount)&&(cache_used+length*sizeof(unsigned short int)<=cache_limit);++index)
+ {
+  try
+  {
+   cache[index]=new unsigned short int[length];
+  }
+  catch (...)
+  {
+   Halt("Can't allocate memory for background cache");
+  }
+  this->convert_frame(index,cache[index]);
+  cache_used+=length*sizeof(unsigned short int);
+ }
+
 }
 
-void Image::destroy_image()
+void Background::prepare_cache()
 {
- width=0;
- height=0;
- this->clear_buffer();
+ size_t amount;
+ amount=0;
+ if ((maximum_width==this->get_surface_width())&&(maximum_height==this->get_surface_height())&&(cache_limit>0))
+ {
+  amount=static_cast<size_t>(this->get_table_size());
+ }
+ if ((cache_amount!=amount)||(cache_revision!=this->get_revision()))
+ {
+  this->create_cache(amount);
+  this->fill_cache();
+ }
+
 }
 
-Surface::Surface()
+void Background::get_maximum_width()
 {
- width=0;
- height=0;
- image=NULL;
- surface=NULL;
+ maximum_width=background_width;
+ if (maximum_width>this->get_surface_width())
+ {
+  maximum_width=this->get_surface_width();
+ }
+
 }
 
-Surface::~Surface()
+void Background::get_maximum_height()
 {
- surface=NULL;
- if (image!=NULL) free(image);
+ maximum_height=background_height;
+ if (maximum_height>this->get_surface_height())
+ {
+  maximum_height=this->get_surface_height();
+ }
+
 }
 
-IMG_Pixel *Surface::create_buffer(const unsigned long int image_width,const unsigned long int image_height)
+unsigned long int Background::move_offset(const unsigned long int offset,const long int delta,const unsigned long int length,const bool wrap) const
 {
- IMG_Pixel *result;
- size_t length;
- length=static_cast<size_t>(image_width)*static_cast<size_t>(image_height);
- result=reinterpret_cast<IMG_Pixel*>(calloc(length,3));
- if (result==NULL)
+ unsigned long int result,distance;
+ result=offset;
+ if (delta<0)
  {
-  Halt("Can't allocate memory for image buffer");
+  distance=static_cast<unsigned long int>(-(delta+1))+1;
+  if ((wrap==true)&&(length>0))
+  {
+   result=(offset%length+length-distance%length)%length;
+  }
+  else
+  {
+   result=0;
+   if (offset>distance) result=offset-distance;
+  }
+
+ }
+ else
+ {
+  result=offset+static_cast<unsigned long int>(delta);
+  if ((wrap==true)&&(length>0)) result%=length;
  }
  return result;
 }
 
-void Surface::save()
+void Background::slow_draw_background()
 {
- surface->save();
+ this->draw_image_region(start,0,0,background_width,background_height,horizontal_flip,vertical_flip);
 }
 
-void Surface::restore()
+void Background::configure_background()
 {
- surface->restore();
+ unsigned long int columns,rows;
+ columns=1;
+ rows=1;
+ switch(current_kind)
+ {
+  case NORMAL_BACKGROUND:
+  break;
+  case HORIZONTAL_BACKGROUND:
+  columns=this->get_frames();
+  break;
+  case VERTICAL_BACKGROUND:
+  rows=this->get_frames();
+  break;
+  case GRID_BACKGROUND:
+  columns=grid_columns;
+  rows=grid_rows;
+  break;
+ }
+ background_width=this->get_image_width()/columns;
+ background_height=this->get_image_height()/rows;
+ this->create_table(columns,rows,background_width,background_height,this->get_stride());
+ table_revision=this->get_revision();
+ this->resolve_key();
+ this->destroy_cache();
+ encoded=false;
 }
 
-void Surface::clear_buffer()
+void Background::check_table()
 {
- if (image!=NULL)
+ if (table_revision!=this->get_revision())
  {
-  free(image);
-  image=NULL;
+  this->configure_background();
+  this->get_maximum_width();
+  this->get_maximum_height();
  }
 
 }
 
-void Surface::set_size(const unsigned long int image_width,const unsigned long int image_height)
+unsigned long int Background::get_width() const
 {
- width=image_width;
- height=image_height;
+ return background_width;
 }
 
-void Surface::set_buffer(IMG_Pixel *buffer)
+unsigned long int Background::get_height() const
 {
- image=buffer;
+ return background_height;
 }
 
-size_t Surface::get_offset(const unsigned long int start,const unsigned long int x,const unsigned long int y,const unsigned long int target_width)
+void Background::set_kind(const BACKGROUND_TYPE kind)
 {
- return static_cast<size_t>(start)+static_cast<size_t>(x)+static_cast<size_t>(y)*static_cast<size_t>(target_width);
+ current_kind=kind;
+ this->configure_background();
+ this->get_maximum_width();
+ this->get_maximum_height();
 }
 
-size_t Surface::get_offset(const unsigned long int start,const unsigned long int x,const unsigned long int y) const
+void Background::set_setting(const BACKGROUND_TYPE kind,const unsigned long int frames)
 {
- return static_cast<size_t>(start)+static_cast<size_t>(x)+static_cast<size_t>(y)*static_cast<size_t>(width);
+ if (kind!=NORMAL_BACKGROUND) this->set_frames(frames);
+ this->set_kind(kind);
 }
 
-void Surface::draw_image_pixel(const size_t offset,const unsigned long int x,const unsigned long int y)
+void Background::set_target(const unsigned long int target)
 {
- surface->draw_pixel(x,y,image[offset].red,image[offset].green,image[offset].blue);
+ this->check_table();
+ this->set_frame(target);
 }
 
-bool Surface::compare_pixels(const size_t first,const size_t second) const
+void Background::set_grid(const unsigned long int columns,const unsigned long int rows)
 {
- bool result;
- result=false;
- if (image[first].red!=image[second].red)
+ if ((columns>0)&&(rows>0))
  {
-  result=true;
-  goto finish;
- }
- if (image[first].green!=image[second].green)
- {
-  result=true;
-  goto finish;
+  grid_columns=columns;
+  grid_rows=rows;
+  this->set_frames(columns*rows);
+  this->set_kind(GRID_BACKGROUND);
  }
- if (image[first].blue!=image[second].blue)
+
+}
+
+void Background::repack_frames()
+{
+ unsigned long int amount;
+ amount=this->get_table_size();
+ if ((amount>0)&&(this->get_stride()!=background_width))
  {
-  result=true;
-  goto finish;
+  this->repack_image(this->get_frame_table(),amount,background_width,background_height);
+  if (amount>1)
+  {
+   this->set_frames(amount);
+   this->set_kind(VERTICAL_BACKGROUND);
+  }
+  else
+  {
+   this->set_kind(NORMAL_BACKGROUND);
+  }
+  current=0;
  }
- finish: ;
- return result;
+
 }
 
-unsigned long int Surface::get_surface_width() const
+void Background::step()
 {
- return surface->get_frame_width();
+ this->check_table();
+ this->increase_frame();
 }
 
-unsigned long int Surface::get_surface_height() const
+void Background::horizontal_mirror()
 {
- return surface->get_frame_height();
+ horizontal_flip=!horizontal_flip;
+ this->destroy_cache();
 }
 
-void Surface::initialize(Screen *screen)
+void Background::vertical_mirror()
 {
- surface=screen;
+ vertical_flip=!vertical_flip;
+ this->destroy_cache();
 }
 
-size_t Surface::get_length() const
+bool Background::get_horizontal_mirror() const
 {
- return static_cast<size_t>(width)*static_cast<size_t>(height)*3;
+ return horizontal_flip;
 }
 
-IMG_Pixel *Surface::get_image()
+bool Background::get_vertical_mirror() const
 {
- return image;
+ return vertical_flip;
 }
 
-void Surface::load_image(Image &buffer)
+void Background::set_wrap(const bool horizontal,const bool vertical)
 {
- width=buffer.get_width();
- height=buffer.get_height();
- this->clear_buffer();
- image=this->create_buffer(width,height);
- memmove(image,buffer.get_data(),buffer.get_length());
+ horizontal_wrap=horizontal;
+ vertical_wrap=vertical;
+ current=0;
 }
 
-unsigned long int Surface::get_image_width() const
+bool Background::get_horizontal_wrap() const
 {
- return width;
+ return horizontal_wrap;
 }
 
-unsigned long int Surface::get_image_height() const
+bool Background::get_vertical_wrap() const
 {
- return height;
+ return vertical_wrap;
 }
 
-void Surface::mirror_image(const MIRROR_TYPE kind)
+void Background::set_offset(const unsigned long int x,const unsigned long int y)
 {
- unsigned long int x,y,index;
- IMG_Pixel *mirrored_image;
- x=0;
- y=0;
- mirrored_image=this->create_buffer(width,height);
- if (kind==MIRROR_HORIZONTAL)
- {
-  for (index=width*height;index>0;--index)
-  {
-   mirrored_image[this->get_offset(0,x,y)]=image[this->get_offset(0,(width-x-1),y)];
-   ++x;
-   if (x==width)
-   {
-    x=0;
-    ++y;
-   }
-
-  }
-
- }
- if (kind==MIRROR_VERTICAL)
- {
-  for (index=width*height;index>0;--index )
-  {
-   mirrored_image[this->get_offset(0,x,y)]=image[this->get_offset(0,x,(height-y-1))];
-   ++x;
-   if (x==width)
-   {
-    x=0;
-    ++y;
-   }
+ scroll_x=this->move_offset(x,0,background_width,horizontal_wrap);
+ scroll_y=this->move_offset(y,0,background_height,vertical_wrap);
+ current=0;
+}
 
-  }
+void Background::scroll(const long int x,const long int y)
+{
+ scroll_x=this->move_offset(scroll_x,x,background_width,horizontal_wrap);
+ scroll_y=this->move_offset(scroll_y,y,background_height,vertical_wrap);
+ current=0;
+}
 
- }
- free(image);
- image=mirrored_image;
+unsigned long int Background::get_offset_x() const
+{
+ return scroll_x;
 }
 
-void Surface::resize_image(const unsigned long int new_width,const unsigned long int new_height)
+unsigned long int Background::get_offset_y() const
 {
- float x_ratio,y_ratio;
- unsigned long int x,y,steps;
- size_t index,location,position;
- IMG_Pixel *scaled_image;
- x=0;
- y=0;
- steps=new_width*new_height;
- scaled_image=this->create_buffer(new_width,new_height);
- x_ratio=static_cast<float>(width)/static_cast<float>(new_width);
- y_ratio=static_cast<float>(height)/static_cast<float>(new_height);
- for (index=0;index<steps;++index)
- {
-  location=this->get_offset(0,x,y,new_width);
-  position=this->get_offset(0,(x_ratio*static_cast<float>(x)),(y_ratio*static_cast<float>(y)),width);
-  scaled_image[location]=image[position];
-  ++x;
-  if (x==new_width)
-  {
-   x=0;
-   ++y;
-  }
+ return scroll_y;
+}
 
- }
- free(image);
- image=scaled_image;
- width=new_width;
- height=new_height;
+void Background::set_transparent(const bool enabled)
+{
+ transparent=enabled;
+ current=0;
 }
 
-void Surface::horizontal_mirror()
+bool Background::get_transparent() const
 {
- this->mirror_image(MIRROR_HORIZONTAL);
+ return transparent;
 }
 
-void Surface::vertical_mirror()
+void Background::set_color_key(const unsigned short int red,const unsigned short int green,const unsigned short int blue)
 {
- this->mirror_image(MIRROR_VERTICAL);
+ custom_key=true;
+ key=pack_pixel(red,green,blue);
 }
 
-Animation::Animation()
+void Background::reset_color_key()
 {
- start=0;
- frame=1;
- frames=1;
+ custom_key=false;
+ this->resolve_key();
 }
 
-Animation::~Animation()
+unsigned short int Background::get_color_key() const
 {
+ return key;
+}
 
+void Background::set_cache_limit(const size_t limit)
+{
+ cache_limit=limit;
+ this->destroy_cache();
 }
 
-void Animation::set_frame(const unsigned long int target)
+size_t Background::get_cache_limit() const
 {
- if (target>0)
+ return cache_limit;
+}
+
+size_t Background::get_cache_usage() const
+{
+ return cache_used;
+}
+
+void Background::draw_layer()
+{
+ size_t row;
+ this->check_table();
+ if (transparent==true)
  {
-  if (target<=frames) frame=target;
+  if (this->check_runs()==false) this->encode_runs();
+  row=static_cast<size_t>(this->get_position())*static_cast<size_t>(background_height);
+  this->draw_scrolled_runs(start,background_width,background_height,runs,row,scroll_x,scroll_y,horizontal_wrap,vertical_wrap,horizontal_flip,vertical_flip);
  }
-
+ else
+ {
+  this->draw_scrolled_image(start,background_width,background_height,scroll_x,scroll_y,horizontal_wrap,vertical_wrap,horizontal_flip,vertical_flip);
+ }
+ current=0;
 }
 
-void Animation::increase_frame()
+void Background::draw_background()
 {
- ++frame;
- if (frame>frames)
+ const unsigned short int *target;
+ this->check_table();
+ if ((scroll_x>0)||(scroll_y>0)||(horizontal_wrap==true)||(vertical_wrap==true)||(transparent==true))
  {
-  frame=1;
+  this->draw_layer();
+ }
+ else
+ {
+  this->prepare_cache();
+  target=NULL;
+  if (cache!=NULL) target=cache[this->get_position()];
+  if ((current==this->get_frame())&&(saves!=this->get_saves())) current=0;
+  if (target!=NULL)
+  {
+   if (current!=this->get_frame())
+   {
+    this->restore(target);
+    current=this->get_frame();
+    saves=this->get_saves();
+   }
+   else
+   {
+    this->restore();
+   }
+
+  }
+  else
+  {
+   if (current!=this->get_frame())
+   {
+    this->slow_draw_background();
+    this->save();
+    current=this->get_frame();
+    saves=this->get_saves();
+   }
+   else
+   {
+    this->restore();
+   }
+
+  }
+
  }
 
 }
 
-void Animation::set_frames(const unsigned long int amount)
+Sprite::Sprite()
 {
- if (amount>1) frames=amount;
+ transparent=true;
+ horizontal_flip=false;
+ vertical_flip=false;
+ encoded=false;
+ encoded_keyed=true;
+ custom_key=false;
+ opacity=UCHAR_MAX;
+ key=0;
+ encoded_key=0;
+ current_x=0;
+ current_y=0;
+ sprite_width=0;
+ sprite_height=0;
+ encoded_revision=0;
+ encoded_frames=0;
+ encoded_width=0;
+ table_revision=0;
+ current_kind=SINGLE_SPRITE;
+ encoded_kind=SINGLE_SPRITE;
+ bounds=NULL;
 }
 
-unsigned long int Animation::get_frames() const
+Sprite::~Sprite()
 {
- return frames;
+ this->destroy_bounds();
 }
 
-unsigned long int Animation::get_frame() const
+void Sprite::destroy_bounds()
 {
- return frame;
+ if (bounds!=NULL)
+ {
+  delete[] bounds;
+  bounds=NULL;
+ }
+
 }
 
-Background::Background()
+void Sprite::create_bounds(const unsigned long int frames)
 {
- background_width=0;
- background_height=0;
- maximum_width=0;
- maximum_height=0;
- current=0;
- current_kind=NORMAL_BACKGROUND;
+ this->destroy_bounds();
+ try
+ {
+  bounds=new Collision_Box[frames+1];
+ }
+ catch (...)
+ {
+  Halt("Can't allocate memory for sprite bounds");
+ }
+
 }
 
-Background::~Background()
+Collision_Box Sprite::get_bounds() const
 {
-
+ Collision_Box target;
+ target=bounds[this->get_position()];
+ if (horizontal_flip==true) target.x=sprite_width-target.x-target.width;
+ if (vertical_flip==true) target.y=sprite_height-target.y-target.height;
+ return target;
 }
 
-void Background::get_maximum_width()
+void Sprite::resolve_key()
 {
- maximum_width=background_width;
- if (maximum_width>this->get_surface_width())
+ if (custom_key==false)
  {
-  maximum_width=this->get_surface_width();
+  if (this->read_image()!=NULL) key=this->read_image()[0];
  }
 
 }
 
-void Background::get_maximum_height()
+bool Sprite::check_keyed() const
 {
- maximum_height=background_height;
- if (maximum_height>this->get_surface_height())
+ bool keyed;
+ keyed=transparent;
+ if ((this->read_alpha()!=NULL)&&(custom_key==false)) keyed=false;
+ return keyed;
+}
+
+bool Sprite::check_runs() const
+{
+ bool valid;
+ valid=false;
+ if (encoded==true)
  {
-  maximum_height=this->get_surface_height();
+  valid=(encoded_revision==this->get_revision())&&(encoded_kind==current_kind)&&(encoded_frames==this->get_table_size())&&(encoded_width==sprite_width)&&(encoded_key==key)&&(encoded_keyed==this->check_keyed());
  }
-
+ return valid;
 }
 
-void Background::slow_draw_background()
+void Sprite::encode_runs()
 {
- unsigned long int x,y,index;
- x=0;
- y=0;
- for (index=maximum_width*maximum_height;index>0;--index)
+ unsigned long int target,frames,y,left,top,right,bottom;
+ size_t amount,row;
+ const unsigned short int *source;
+ const unsigned char *alpha;
+ bool keyed;
+ frames=this->get_table_size();
+ if (encoded_revision!=this->get_revision()) this->resolve_key();
+ keyed=this->check_keyed();
+ amount=0;
+ for (target=0;target<frames;++target)
  {
-  this->draw_image_pixel(this->get_offset(start,x,y),x,y);
-  ++x;
-  if (x==maximum_width)
+  source=this->read_image()+this->get_frame_offset(target);
+  alpha=NULL;
+  if (this->read_alpha()!=NULL) alpha=this->read_alpha()+this->get_frame_offset(target);
+  for (y=0;y<sprite_height;++y)
   {
-   x=0;
-   ++y;
+   amount+=runs.count_runs(source,alpha,sprite_width,key,keyed);
+   source+=this->get_stride();
+   if (alpha!=NULL) alpha+=this->get_stride();
+  }
+
+ }
+ runs.create_runs(static_cast<size_t>(frames)*static_cast<size_t>(sprite_height),amount);
+ for (target=0;target<frames;++target)
+ {
+  source=this->read_image()+this->get_frame_offset(target);
+  alpha=NULL;
+  if (this->read_alpha()!=NULL) alpha=this->read_alpha()+this->get_frame_offset(target);
+  for (y=0;y<sprite_height;++y)
+  {
+   runs.add_row(source,alpha,sprite_width,key,keyed);
+   source+=this->get_stride();
+   if (alpha!=NULL) alpha+=this->get_stride();
+  }
+
+ }
+ mask.create_mask(static_cast<size_t>(frames)*static_cast<size_t>(sprite_height),sprite_width);
+ this->create_bounds(frames);
+ row=0;
+ for (target=0;target<frames;++target)
+ {
+  left=sprite_width;
+  right=0;
+  top=sprite_height;
+  bottom=0;
+  for (y=0;y<sprite_height;++y)
+  {
+   mask.add_row(row,runs,row);
+   if (runs.get_first(row)<runs.get_last(row))
+   {
+    if (top==sprite_height) top=y;
+    bottom=y+1;
+    if (runs.get_run(runs.get_first(row)).offset<left) left=runs.get_run(runs.get_first(row)).offset;
+    if (runs.get_run(runs.get_last(row)-1).offset+runs.get_run(runs.get_last(row)-1).length>right) right=runs.get_run(runs.get_last(row)-1).offset+runs.get_run(runs.get_last(row)-1).length;
+   }
+   ++row;
+  }
+  bounds[target].x=0;
+  bounds[target].y=0;
+  bounds[target].width=0;
+  bounds[target].height=0;
+  if (top<bottom)
+  {
+   bounds[target].x=left;
+   bounds[target].y=top;
+   bounds[target].width=right-left;
+   bounds[target].height=bottom-top;
   }
 
  }
+ encoded=true;
+ encoded_revision=this->get_revision();
+ encoded_kind=current_kind;
+ encoded_frames=frames;
+ encoded_width=sprite_width;
+ encoded_key=key;
+ encoded_keyed=keyed;
+}
 
+void Sprite::prepare_runs()
+{
+ if ((this->read_image()!=NULL)&&(this->check_runs()==false)) this->encode_runs();
 }
 
-void Background::configure_background()
+void Sprite::configure_kind(const SPRITE_TYPE kind)
 {
- switch(current_kind)
+ unsigned long int columns,rows;
+ columns=1;
+ rows=1;
+ switch(kind)
  {
-  case NORMAL_BACKGROUND:
-  background_width=this->get_image_width();
-  background_height=this->get_image_height();
-  start=0;
+  case SINGLE_SPRITE:
   break;
-  case HORIZONTAL_BACKGROUND:
-  background_width=this->get_image_width()/this->get_frames();
-  background_height=this->get_image_height();
-  start=(this->get_frame()-1)*background_width;
+  case HORIZONTAL_STRIP:
+  columns=this->get_frames();
   break;
-  case VERTICAL_BACKGROUND:
-  background_width=this->get_image_width();
-  background_height=this->get_image_height()/this->get_frames();
-  start=(this->get_frame()-1)*background_width*background_height;
+  case VERTICAL_STRIP:
+  rows=this->get_frames();
+  break;
+  case GRID_SHEET:
+  columns=grid_columns;
+  rows=grid_rows;
   break;
  }
-
+ sprite_width=this->get_image_width()/columns;
+ sprite_height=this->get_image_height()/rows;
+ this->create_table(columns,rows,sprite_width,sprite_height,this->get_stride());
+ table_revision=this->get_revision();
+ current_kind=kind;
 }
 
-unsigned long int Background::get_width() const
+void Sprite::check_table()
 {
- return background_width;
+ if (table_revision!=this->get_revision()) this->configure_kind(current_kind);
 }
 
-unsigned long int Background::get_height() const
+void Sprite::draw_transparent_sprite()
 {
- return background_height;
-}
+ Collision_Box source,target;
+ size_t row,offset;
+ if (this->check_runs()==false) this->encode_runs();
+ source=bounds[this->get_position()];
+ if (source.height>0)
+ {
+  target=this->get_bounds();
+  row=static_cast<size_t>(this->get_position())*static_cast<size_t>(sprite_height)+static_cast<size_t>(source.y);
+  offset=start+static_cast<size_t>(source.y)*static_cast<size_t>(this->get_stride());
+  this->draw_image_runs(offset+source.x,current_x+target.x,current_y+target.y,source.width,source.height,runs,row,source.x,horizontal_flip,vertical_flip);
+ }
 
-void Background::set_kind(const BACKGROUND_TYPE kind)
-{
- current_kind=kind;
- this->configure_background();
- this->get_maximum_width();
- this->get_maximum_height();
 }
 
-void Background::set_setting(const BACKGROUND_TYPE kind,const unsigned long int frames)
+void Sprite::draw_normal_sprite()
 {
- if (kind!=NORMAL_BACKGROUND) this->set_frames(frames);
- this->set_kind(kind);
+ this->draw_image_region(start,current_x,current_y,sprite_width,sprite_height,horizontal_flip,vertical_flip);
 }
 
-void Background::set_target(const unsigned long int target)
+void Sprite::draw_blended_sprite()
 {
- this->set_frame(target);
- this->set_kind(current_kind);
-}
+ Collision_Box source,target;
+ size_t row,offset;
+ if (this->check_runs()==false) this->encode_runs();
+ source=bounds[this->get_position()];
+ if (source.height>0)
+ {
+  target=this->get_bounds();
+  row=static_cast<size_t>(this->get_position())*static_cast<size_t>(sprite_height)+static_cast<size_t>(source.y);
+  offset=start+static_cast<size_t>(source.y)*static_cast<size_t>(this->get_stride());
+  this->draw_blended_image(offset+source.x,current_x+target.x,current_y+target.y,source.width,source.height,runs,row,source.x,opacity,horizontal_flip,vertical_flip);
+ }
 
-void Background::step()
-{
- this->increase_frame();
- this->set_kind(current_kind);
 }
 
-void Background::draw_background()
+const unsigned int *Sprite::get_mask_row(const unsigned long int y) const
 {
- if (current!=this->get_frame())
+ size_t row;
+ row=static_cast<size_t>(this->get_position())*static_cast<size_t>(sprite_height);
+ if (vertical_flip==true)
  {
-  this->slow_draw_background();
-  this->save();
-  current=this->get_frame();
+  row+=static_cast<size_t>(sprite_height-y-1);
  }
  else
  {
-  this->restore();
+  row+=static_cast<size_t>(y);
  }
+ return mask.get_row(row,horizontal_flip);
+}
 
+void Sprite::load_sprite(Image &buffer,const SPRITE_TYPE kind,const unsigned long int frames)
+{
+ this->load_image(buffer);
+ if (kind!=SINGLE_SPRITE) this->set_frames(frames);
+ this->resolve_key();
+ this->set_kind(kind);
 }
 
-Sprite::Sprite()
+void Sprite::load_sprite(Atlas &atlas,const unsigned long int index,const SPRITE_TYPE kind,const unsigned long int frames)
 {
- transparent=true;
- current_x=0;
- current_y=0;
- sprite_width=0;
- sprite_height=0;
- current_kind=SINGLE_SPRITE;
+ this->load_image(atlas,index);
+ if (kind!=SINGLE_SPRITE) this->set_frames(frames);
+ this->resolve_key();
+ this->set_kind(kind);
 }
 
-Sprite::~Sprite()
+void Sprite::load_sheet(Image &buffer,const unsigned long int columns,const unsigned long int rows)
 {
+ if ((columns>0)&&(rows>0))
+ {
+  this->load_image(buffer);
+  grid_columns=columns;
+  grid_rows=rows;
+  this->set_frames(columns*rows);
+  this->resolve_key();
+  this->set_kind(GRID_SHEET);
+ }
 
 }
 
-void Sprite::draw_transparent_sprite()
+void Sprite::load_sheet(Atlas &atlas,const unsigned long int index,const unsigned long int columns,const unsigned long int rows)
 {
- unsigned long int x,y,index;
- x=0;
- y=0;
- for (index=sprite_width*sprite_height;index>0;--index)
+ if ((columns>0)&&(rows>0))
+ {
+  this->load_image(atlas,index);
+  grid_columns=columns;
+  grid_rows=rows;
+  this->set_frames(columns*rows);
+  this->resolve_key();
+  this->set_kind(GRID_SHEET);
+ }
+
+}
+
+void Sprite::repack_frames()
+{
+ unsigned long int amount;
+ amount=this->get_table_size();
+ if ((amount>0)&&(this->get_stride()!=sprite_width))
  {
-  if (this->compare_pixels(0,this->get_offset(start,x,y))==true)
+  this->repack_image(this->get_frame_table(),amount,sprite_width,sprite_height);
+  if (amount>1)
   {
-   this->draw_image_pixel(this->get_offset(start,x,y),x+current_x,y+current_y);
+   this->set_frames(amount);
+   this->set_kind(VERTICAL_STRIP);
   }
-  ++x;
-  if (x==sprite_width)
+  else
   {
-   x=0;
-   ++y;
+   this->set_kind(SINGLE_SPRITE);
   }
 
  }
 
 }
 
-void Sprite::draw_normal_sprite()
+void Sprite::set_transparent(const bool enabled)
 {
- unsigned long int x,y,index;
- x=0;
- y=0;
- for (index=sprite_width*sprite_height;index>0;--index)
- {
-  this->draw_image_pixel(this->get_offset(start,x,y),x+current_x,y+current_y);
-  ++x;
-  if (x==sprite_width)
-  {
-   x=0;
-   ++y;
-  }
+ transparent=enabled;
+}
 
- }
+bool Sprite::get_transparent() const
+{
+ return transparent;
+}
+
+void Sprite::set_color_key(const unsigned short int red,const unsigned short int green,const unsigned short int blue)
+{
+ custom_key=true;
+ key=pack_pixel(red,green,blue);
+ this->prepare_runs();
+}
 
+void Sprite::reset_color_key()
+{
+ custom_key=false;
+ this->resolve_key();
+ this->prepare_runs();
 }
 
-void Sprite::load_sprite(Image &buffer,const SPRITE_TYPE kind,const unsigned long int frames)
+unsigned short int Sprite::get_color_key() const
 {
- this->load_image(buffer);
- if (kind!=SINGLE_SPRITE) this->set_frames(frames);
- this->set_kind(kind);
+ return key;
 }
 
-void Sprite::set_transparent(const bool enabled)
+void Sprite::set_opacity(const unsigned char amount)
 {
- transparent=enabled;
+ opacity=amount;
 }
 
-bool Sprite::get_transparent() const
+unsigned char Sprite::get_opacity() const
 {
- return transparent;
+ return opacity;
 }
 
 void Sprite::set_x(const unsigned long int x)
@@ -2253,27 +5699,48 @@ Collision_Box Sprite::get_box() const
  return target;
 }
 
-void Sprite::set_kind(const SPRITE_TYPE kind)
+Collision_Box Sprite::get_opaque_box()
 {
- switch(kind)
+ Collision_Box target;
+ this->check_table();
+ if (this->check_runs()==false) this->encode_runs();
+ target=this->get_bounds();
+ target.x+=current_x;
+ target.y+=current_y;
+ return target;
+}
+
+bool Sprite::check_pixel_collision(Sprite &target)
+{
+ Collision_Box first,second;
+ unsigned long int left,top,right,bottom,y;
+ bool result;
+ result=false;
+ first=this->get_opaque_box();
+ second=target.get_opaque_box();
+ left=first.x;
+ top=first.y;
+ right=first.x+first.width;
+ bottom=first.y+first.height;
+ if (second.x>left) left=second.x;
+ if (second.y>top) top=second.y;
+ if (second.x+second.width<right) right=second.x+second.width;
+ if (second.y+second.height<bottom) bottom=second.y+second.height;
+ if ((left<right)&&(top<bottom))
  {
-  case SINGLE_SPRITE:
-  sprite_width=this->get_image_width();
-  sprite_height=this->get_image_height();
-  start=0;
-  break;
-  case HORIZONTAL_STRIP:
-  sprite_width=this->get_image_width()/this->get_frames();
-  sprite_height=this->get_image_height();
-  start=(this->get_frame()-1)*sprite_width;
-  break;
-  case VERTICAL_STRIP:
-  sprite_width=this->get_image_width();
-  sprite_height=this->get_image_height()/this->get_frames();
-  start=(this->get_frame()-1)*sprite_width*sprite_height;
-  break;
+  for (y=top;(y<bottom)&&(result==false);++y)
+  {
+   result=Collision_Mask::check_rows(this->get_mask_row(y-current_y),left-current_x,target.get_mask_row(y-target.current_y),left-target.current_x,right-left);
+  }
+
  }
- current_kind=kind;
+ return result;
+}
+
+void Sprite::set_kind(const SPRITE_TYPE kind)
+{
+ this->configure_kind(kind);
+ this->prepare_runs();
 }
 
 SPRITE_TYPE Sprite::get_kind() const
@@ -2283,14 +5750,14 @@ SPRITE_TYPE Sprite::get_kind() const
 
 void Sprite::set_target(const unsigned long int target)
 {
+ this->check_table();
  this->set_frame(target);
- this->set_kind(current_kind);
 }
 
 void Sprite::step()
 {
+ this->check_table();
  this->increase_frame();
- this->set_kind(current_kind);
 }
 
 void Sprite::set_position(const unsigned long int x,const unsigned long int y)
@@ -2299,25 +5766,79 @@ void Sprite::set_position(const unsigned long int x,const unsigned long int y)
  current_y=y;
 }
 
+void Sprite::horizontal_mirror()
+{
+ horizontal_flip=!horizontal_flip;
+}
+
+void Sprite::vertical_mirror()
+{
+ vertical_flip=!vertical_flip;
+}
+
+bool Sprite::get_horizontal_mirror() const
+{
+ return horizontal_flip;
+}
+
+bool Sprite::get_vertical_mirror() const
+{
+ return vertical_flip;
+}
+
 void Sprite::clone(Sprite &target)
 {
- this->set_size(target.get_image_width(),target.get_image_height());
+ this->share_image(target);
+ grid_columns=target.grid_columns;
+ grid_rows=target.grid_rows;
  this->set_frames(target.get_frames());
- this->set_kind(target.get_kind());
+ this->configure_kind(target.get_kind());
  this->set_transparent(target.get_transparent());
- this->set_buffer(this->create_buffer(target.get_image_width(),target.get_image_width()));
- memmove(this->get_image(),target.get_image(),target.get_length());
+ custom_key=target.custom_key;
+ opacity=target.opacity;
+ horizontal_flip=target.horizontal_flip;
+ vertical_flip=target.vertical_flip;
+ key=target.key;
+ encoded=false;
+ if (target.check_runs()==true)
+ {
+  runs.copy_runs(target.runs);
+  mask.copy_mask(target.mask);
+  this->create_bounds(target.encoded_frames);
+  memmove(bounds,target.bounds,target.encoded_frames*sizeof(Collision_Box));
+  encoded=true;
+  encoded_revision=this->get_revision();
+  encoded_frames=target.encoded_frames;
+  encoded_width=target.encoded_width;
+  encoded_kind=target.encoded_kind;
+  encoded_key=target.encoded_key;
+  encoded_keyed=target.encoded_keyed;
+ }
+ else
+ {
+  this->prepare_runs();
+ }
+
 }
 
 void Sprite::draw_sprite()
 {
- if (transparent==true)
+ this->check_table();
+ if ((this->read_alpha()!=NULL)||(opacity<UCHAR_MAX))
  {
-  this->draw_transparent_sprite();
+  this->draw_blended_sprite();
  }
  else
  {
-  this->draw_normal_sprite();
+  if (transparent==true)
+  {
+   this->draw_transparent_sprite();
+  }
+  else
+  {
+   this->draw_normal_sprite();
+  }
+
  }
 
 }
@@ -2340,6 +5861,19 @@ void Sprite::draw_sprite(const bool transparency,const unsigned long int x,const
  this->draw_sprite(x,y);
 }
 
+void Sprite::draw_rotated_sprite(const double angle,const double scale)
+{
+ this->check_table();
+ if (encoded_revision!=this->get_revision()) this->resolve_key();
+ this->draw_transformed_image(start,current_x,current_y,sprite_width,sprite_height,angle,scale,this->check_keyed(),key,horizontal_flip,vertical_flip);
+}
+
+void Sprite::draw_rotated_sprite(const double angle,const double scale,const unsigned long int x,const unsigned long int y)
+{
+ this->set_position(x,y);
+ this->draw_rotated_sprite(angle,scale);
+}
+
 Tileset::Tileset()
 {
  offset=0;
@@ -2388,6 +5922,7 @@ void Tileset::draw_tile(const unsigned long int x,const unsigned long int y)
  unsigned long int tile_x,tile_y,index;
  tile_x=0;
  tile_y=0;
+ this->invalidate(x,y,tile_width,tile_height);
  for (index=tile_width*tile_height;index>0;--index)
  {
   this->draw_image_pixel(offset+this->get_offset(0,tile_x,tile_y),x+tile_x,y+tile_y);
@@ -2421,6 +5956,267 @@ void Tileset::load_tileset(Image &buffer,const unsigned long int row_amount,cons
 
 }
 
+Atlas::Atlas()
+{
+ regions=NULL;
+ images=NULL;
+ masks=NULL;
+ amount=0;
+ capacity=0;
+ packed=false;
+}
+
+Atlas::~Atlas()
+{
+ this->destroy_pending();
+ if (regions!=NULL)
+ {
+  delete[] regions;
+  regions=NULL;
+ }
+
+}
+
+void Atlas::grow_list()
+{
+ size_t index,size;
+ Atlas_Region *next_regions;
+ unsigned short int **next_images;
+ unsigned char **next_masks;
+ next_regions=NULL;
+ next_images=NULL;
+ next_masks=NULL;
+ size=2*capacity;
+ if (size==0) size=8;
+ try
+ {
+  next_regions=new Atlas_Region[size];
+  next_images=new unsigned short int*[size];
+  next_masks=new unsigned char*[size];
+ }
+ catch (...)
+ {
+  Halt("Can't allocate memory for atlas");
+ }
+ for (index=0;index<amount;++index)
+ {
+  next_regions[index]=regions[index];
+  next_images[index]=images[index];
+  next_masks[index]=masks[index];
+ }
+ if (regions!=NULL) delete[] regions;
+ if (images!=NULL) delete[] images;
+ if (masks!=NULL) delete[] masks;
+ regions=next_regions;
+ images=next_images;
+ masks=next_masks;
+ capacity=size;
+}
+
+void Atlas::destroy_pending()
+{
+ size_t index;
+ if (images!=NULL)
+ {
+  for (index=0;index<amount;++index)
+  {
+   if (images[index]!=NULL) free(images[index]);
+   if (masks[index]!=NULL) free(masks[index]);
+  }
+  delete[] images;
+  delete[] masks;
+  images=NULL;
+  masks=NULL;
+ }
+
+}
+
+unsigned long int Atlas::get_atlas_width() const
+{
+ unsigned long int result;
+ size_t index,area;
+ result=0;
+ area=0;
+ for (index=0;index<amount;++index)
+ {
+  if (regions[index].width>result) result=regions[index].width;
+  area+=static_cast<size_t>(regions[index].width)*static_cast<size_t>(regions[index].height);
+ }
+ while (static_cast<size_t>(result)*static_cast<size_t>(result)<area)
+ {
+  ++result;
+ }
+ return result;
+}
+
+size_t *Atlas::sort_regions()
+{
+ size_t index,position,current;
+ size_t *order;
+ order=NULL;
+ try
+ {
+  order=new size_t[amount];
+ }
+ catch (...)
+ {
+  Halt("Can't allocate memory for atlas");
+ }
+ for (index=0;index<amount;++index)
+ {
+  current=index;
+  position=index;
+  while ((position>0)&&(regions[order[position-1]].height<regions[current].height))
+  {
+   order[position]=order[position-1];
+   --position;
+  }
+  order[position]=current;
+ }
+ return order;
+}
+
+void Atlas::place_regions(const size_t *order,const unsigned long int atlas_width)
+{
+ size_t index;
+ unsigned long int x,y,shelf;
+ Atlas_Region *region;
+ x=0;
+ y=0;
+ shelf=0;
+ for (index=0;index<amount;++index)
+ {
+  region=regions+order[index];
+  if (x+region->width>atlas_width)
+  {
+   x=0;
+   y+=shelf;
+   shelf=0;
+  }
+  region->x=x;
+  region->y=y;
+  x+=region->width;
+  if (region->height>shelf) shelf=region->height;
+ }
+
+}
+
+unsigned long int Atlas::get_atlas_height() const
+{
+ unsigned long int result;
+ size_t index;
+ result=0;
+ for (index=0;index<amount;++index)
+ {
+  if (regions[index].y+regions[index].height>result) result=regions[index].y+regions[index].height;
+ }
+ return result;
+}
+
+void Atlas::copy_regions(unsigned short int *target,unsigned char *mask,const unsigned long int atlas_width)
+{
+ size_t index,row,source,offset;
+ unsigned long int y;
+ for (index=0;index<amount;++index)
+ {
+  row=static_cast<size_t>(regions[index].width);
+  for (y=0;y<regions[index].height;++y)
+  {
+   source=static_cast<size_t>(y)*row;
+   offset=this->get_offset(0,regions[index].x,regions[index].y+y,atlas_width);
+   memmove(target+offset,images[index]+source,row*sizeof(unsigned short int));
+   if (masks[index]!=NULL) memmove(mask+offset,masks[index]+source,row);
+  }
+
+ }
+
+}
+
+unsigned long int Atlas::add_image(Image &buffer)
+{
+ if (packed==true)
+ {
+  Halt("Can't add image to packed atlas");
+ }
+ if (amount==capacity) this->grow_list();
+ regions[amount].x=0;
+ regions[amount].y=0;
+ regions[amount].width=buffer.get_width();
+ regions[amount].height=buffer.get_height();
+ regions[amount].translucent=buffer.get_alpha()!=NULL;
+ images[amount]=this->pack_image(buffer);
+ masks[amount]=this->copy_alpha(buffer);
+ ++amount;
+ return amount-1;
+}
+
+unsigned long int Atlas::add_tga(const char *name)
+{
+ Image buffer;
+ buffer.load_tga(name);
+ return this->add_image(buffer);
+}
+
+unsigned long int Atlas::add_pcx(const char *name)
+{
+ Image buffer;
+ buffer.load_pcx(name);
+ return this->add_image(buffer);
+}
+
+void Atlas::pack()
+{
+ size_t index;
+ unsigned long int atlas_width,atlas_height;
+ size_t *order;
+ unsigned short int *target;
+ unsigned char *mask;
+ if ((packed==false)&&(amount>0))
+ {
+  atlas_width=this->get_atlas_width();
+  order=this->sort_regions();
+  this->place_regions(order,atlas_width);
+  delete[] order;
+  atlas_height=this->get_atlas_height();
+  target=this->create_buffer(atlas_width,atlas_height);
+  mask=NULL;
+  for (index=0;index<amount;++index)
+  {
+   if (masks[index]!=NULL)
+   {
+    mask=this->create_alpha(atlas_width,atlas_height);
+    break;
+   }
+
+  }
+  this->copy_regions(target,mask,atlas_width);
+  this->destroy_pending();
+  this->set_size(atlas_width,atlas_height);
+  this->set_buffer(target,mask);
+  packed=true;
+ }
+
+}
+
+bool Atlas::is_packed() const
+{
+ return packed;
+}
+
+unsigned long int Atlas::get_amount() const
+{
+ return amount;
+}
+
+Atlas_Region Atlas::get_region(const unsigned long int index) const
+{
+ if ((packed==false)||(index>=amount))
+ {
+  Halt("Invalid atlas region");
+ }
+ return regions[index];
+}
+
 Text::Text()
 {
  current_x=0;
@@ -2564,4 +6360,191 @@ Collision_Box Collision::generate_box(const unsigned long int x,const unsigned l
  return result;
 }
 
+Parallax::Parallax()
+{
+ surface=NULL;
+ targets=NULL;
+ layers=NULL;
+ amount=0;
+ capacity=0;
+ saved=0;
+ saves=0;
+ camera_x=0;
+ camera_y=0;
+}
+
+Parallax::~Parallax()
+{
+ this->destroy_layers();
+}
+
+void Parallax::destroy_layers()
+{
+ if (targets!=NULL)
+ {
+  delete[] targets;
+  targets=NULL;
+ }
+ if (layers!=NULL)
+ {
+  delete[] layers;
+  layers=NULL;
+ }
+ amount=0;
+ capacity=0;
+ saved=0;
+}
+
+void Parallax::grow_layers()
+{
+ size_t index,size;
+ Background **next_targets;
+ Parallax_Layer *next_layers;
+ next_targets=NULL;
+ next_layers=NULL;
+ size=2*capacity;
+ if (size==0) size=4;
+ try
+ {
+  next_targets=new Background*[size];
+  next_layers=new Parallax_Layer[size];
+ }
+ catch (...)
+ {
+  Halt("Can't allocate memory for parallax layers");
+ }
+ for (index=0;index<amount;++index)
+ {
+  next_targets[index]=targets[index];
+  next_layers[index]=layers[index];
+ }
+ if (targets!=NULL) delete[] targets;
+ if (layers!=NULL) delete[] layers;
+ targets=next_targets;
+ layers=next_layers;
+ capacity=size;
+}
+
+bool Parallax::check_layer(const size_t index) const
+{
+ bool result;
+ result=layers[index].drawn;
+ if (result==true)
+ {
+  result=(layers[index].offset_x==targets[index]->get_offset_x())&&(layers[index].offset_y==targets[index]->get_offset_y())&&(layers[index].frame==targets[index]->get_frame());
+  if (result==true)
+  {
+   result=(layers[index].revision==targets[index]->get_revision())&&(layers[index].key==targets[index]->get_color_key())&&(layers[index].transparent==targets[index]->get_transparent());
+  }
+  if (result==true)
+  {
+   result=(layers[index].horizontal==targets[index]->get_horizontal_mirror())&&(layers[index].vertical==targets[index]->get_vertical_mirror());
+  }
+  if (result==true)
+  {
+   result=(layers[index].horizontal_wrap==targets[index]->get_horizontal_wrap())&&(layers[index].vertical_wrap==targets[index]->get_vertical_wrap());
+  }
+  if (result==true)
+  {
+   result=(layers[index].width==targets[index]->get_width())&&(layers[index].height==targets[index]->get_height());
+  }
+
+ }
+ return result;
+}
+
+void Parallax::update_layer(const size_t index)
+{
+ layers[index].offset_x=targets[index]->get_offset_x();
+ layers[index].offset_y=targets[index]->get_offset_y();
+ layers[index].frame=targets[index]->get_frame();
+ layers[index].revision=targets[index]->get_revision();
+ layers[index].key=targets[index]->get_color_key();
+ layers[index].transparent=targets[index]->get_transparent();
+ layers[index].horizontal=targets[index]->get_horizontal_mirror();
+ layers[index].vertical=targets[index]->get_vertical_mirror();
+ layers[index].horizontal_wrap=targets[index]->get_horizontal_wrap();
+ layers[index].vertical_wrap=targets[index]->get_vertical_wrap();
+ layers[index].width=targets[index]->get_width();
+ layers[index].height=targets[index]->get_height();
+ layers[index].drawn=true;
+}
+
+void Parallax::initialize(Screen *screen)
+{
+ surface=screen;
+ saved=0;
+}
+
+void Parallax::add_layer(Background &target,const double factor_x,const double factor_y)
+{
+ if ((factor_x<0)||(factor_y<0))
+ {
+  Halt("Invalid parallax factor");
+ }
+ if (amount==capacity) this->grow_layers();
+ targets[amount]=&target;
+ layers[amount].factor_x=factor_x;
+ layers[amount].factor_y=factor_y;
+ layers[amount].drawn=false;
+ ++amount;
+}
+
+size_t Parallax::get_amount() const
+{
+ return amount;
+}
+
+void Parallax::set_camera(const unsigned long int x,const unsigned long int y)
+{
+ camera_x=x;
+ camera_y=y;
+}
+
+unsigned long int Parallax::get_camera_x() const
+{
+ return camera_x;
+}
+
+unsigned long int Parallax::get_camera_y() const
+{
+ return camera_y;
+}
+
+void Parallax::draw_layers()
+{
+ size_t index,first;
+ if (surface!=NULL)
+ {
+  first=amount;
+  for (index=0;index<amount;++index)
+  {
+   targets[index]->set_offset(static_cast<unsigned long int>(camera_x*layers[index].factor_x),static_cast<unsigned long int>(camera_y*layers[index].factor_y));
+   if ((first==amount)&&(this->check_layer(index)==false)) first=index;
+  }
+  if ((first<saved)||(surface->get_saves()!=saves)) saved=0;
+  if (saved>0) surface->restore();
+  for (index=saved;index<first;++index)
+  {
+   targets[index]->draw_layer();
+  }
+  if (first>saved)
+  {
+   surface->save();
+   saves=surface->get_saves();
+   saved=first;
+  }
+  for (index=first;index<amount;++index)
+  {
+   targets[index]->draw_layer();
+  }
+  for (index=0;index<amount;++index)
+  {
+   this->update_layer(index);
+  }
+
+ }
+
+}
+
 }
\ No newline at end of file
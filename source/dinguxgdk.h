@@ -26,6 +26,7 @@ SVGALib homepage: http://www.svgalib.org/
 */
 
 #include <limits.h>
+#include <math.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -34,16 +35,26 @@ SVGALib homepage: http://www.svgalib.org/
 #include <new>
 #include <fcntl.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <errno.h>
+#include <sys/stat.h>
 #include <sys/sysinfo.h>
+#include <sys/mman.h>
 #include <sys/ioctl.h>
 #include <sys/soundcard.h>
 #include <linux/input.h>
 #include <linux/fb.h>
 
+#ifndef FBIO_WAITFORVSYNC
+#define FBIO_WAITFORVSYNC _IOW('F',0x20,__u32)
+#endif
+
 enum GAMEPAD_BUTTONS {BUTTON_UP=0,BUTTON_DOWN=1,BUTTON_LEFT=2,BUTTON_RIGHT=3,BUTTON_A=4,BUTTON_B=5,BUTTON_C=6,BUTTON_X=7,BUTTON_Y=8,BUTTON_Z=9,BUTTON_R=10,BUTTON_L=11,BUTTON_START=12,BUTTON_MENU=13,BUTTON_POWER=14,BUTTON_HOLD=15};
 enum MIRROR_TYPE {MIRROR_HORIZONTAL=0,MIRROR_VERTICAL=1};
-enum BACKGROUND_TYPE {NORMAL_BACKGROUND=0,HORIZONTAL_BACKGROUND=1,VERTICAL_BACKGROUND=2};
-enum SPRITE_TYPE {SINGLE_SPRITE=0,HORIZONTAL_STRIP=1,VERTICAL_STRIP=2};
+enum BACKGROUND_TYPE {NORMAL_BACKGROUND=0,HORIZONTAL_BACKGROUND=1,VERTICAL_BACKGROUND=2,GRID_BACKGROUND=3};
+enum SPRITE_TYPE {SINGLE_SPRITE=0,HORIZONTAL_STRIP=1,VERTICAL_STRIP=2,GRID_SHEET=3};
+enum PIXEL_FORMAT {FORMAT_RGB565=0,FORMAT_RGB555=1,FORMAT_XRGB8888=2,FORMAT_XBGR8888=3};
 
 struct WAVE_head
 {
@@ -116,6 +127,49 @@ struct PCX_head
  unsigned char filled[54];
 };
 
+struct Dirty_Region
+{
+ unsigned long int left;
+ unsigned long int top;
+ unsigned long int right;
+ unsigned long int bottom;
+};
+
+struct Opaque_Run
+{
+ unsigned long int offset;
+ unsigned long int length;
+ bool translucent;
+};
+
+struct Atlas_Region
+{
+ unsigned long int x;
+ unsigned long int y;
+ unsigned long int width;
+ unsigned long int height;
+ bool translucent;
+};
+
+struct Parallax_Layer
+{
+ double factor_x;
+ double factor_y;
+ unsigned long int offset_x;
+ unsigned long int offset_y;
+ unsigned long int frame;
+ unsigned long int revision;
+ unsigned long int width;
+ unsigned long int height;
+ unsigned short int key;
+ bool transparent;
+ bool horizontal;
+ bool vertical;
+ bool horizontal_wrap;
+ bool vertical_wrap;
+ bool drawn;
+};
+
 struct Collision_Box
 {
  unsigned long int x;
@@ -128,27 +182,106 @@ namespace DINGUXGDK
 {
 
 void* oss_play_sound(void *buffer);
+void oss_write_head(const int device,const unsigned long int rate,const size_t length);
+void* present_frames(void *target);
 void Halt(const char *message);
+double get_time();
+const char *get_device(const char *variable,const char *name);
+bool check_file(const int target);
+unsigned short int pack_pixel(const unsigned short int red,const unsigned short int green,const unsigned short int blue);
+unsigned short int blend_pixel(const unsigned short int target,const unsigned short int source,const unsigned int level);
+
+class Dirty_Regions
+{
+ private:
+ Dirty_Region *regions;
+ size_t amount;
+ size_t last;
+ bool full;
+ bool check_touch(const Dirty_Region &target,const unsigned long int left,const unsigned long int top,const unsigned long int right,const unsigned long int bottom) const;
+ unsigned long int get_growth(const Dirty_Region &target,const unsigned long int left,const unsigned long int top,const unsigned long int right,const unsigned long int bottom) const;
+ void merge_region(const size_t index,const unsigned long int left,const unsigned long int top,const unsigned long int right,const unsigned long int bottom);
+ public:
+ Dirty_Regions();
+ ~Dirty_Regions();
+ void add_region(const unsigned long int left,const unsigned long int top,const unsigned long int right,const unsigned long int bottom);
+ void add_regions(const Dirty_Regions &target);
+ void set_full();
+ void clear();
+ bool check_full() const;
+ size_t get_amount() const;
+ const Dirty_Region &get_region(const size_t index) const;
+};
+
+class Opaque_Runs
+{
+ private:
+ Opaque_Run *runs;
+ size_t *rows;
+ size_t amount;
+ size_t row_amount;
+ size_t row;
+ unsigned char classify(const unsigned short int *source,const unsigned char *alpha,const unsigned long int x,const unsigned short int key,const bool keyed) const;
+ public:
+ Opaque_Runs();
+ ~Opaque_Runs();
+ void destroy_runs();
+ void copy_runs(const Opaque_Runs &target);
+ size_t count_runs(const unsigned short int *source,const unsigned char *alpha,const unsigned long int width,const unsigned short int key,const bool keyed) const;
+ void create_runs(const size_t rows_amount,const size_t runs_amount);
+ void add_row(const unsigned short int *source,const unsigned char *alpha,const unsigned long int width,const unsigned short int key,const bool keyed);
+ size_t get_first(const size_t target) const;
+ size_t get_last(const size_t target) const;
+ const Opaque_Run &get_run(const size_t index) const;
+};
+
+class Collision_Mask
+{
+ private:
+ unsigned int *mask;
+ size_t pitch;
+ size_t row_amount;
+ unsigned long int mask_width;
+ void set_span(unsigned int *target,const unsigned long int offset,const unsigned long int length);
+ static unsigned int get_word(const unsigned int *target,const unsigned long int offset);
+ public:
+ Collision_Mask();
+ ~Collision_Mask();
+ void destroy_mask();
+ void copy_mask(const Collision_Mask &target);
+ void create_mask(const size_t rows_amount,const unsigned long int width);
+ void add_row(const size_t target,const Opaque_Runs &runs,const size_t row);
+ const unsigned int *get_row(const size_t target,const bool mirror) const;
+ static bool check_rows(const unsigned int *first,const unsigned long int first_offset,const unsigned int *second,const unsigned long int second_offset,const unsigned long int length);
+};
 
 class Frame
 {
  private:
+ bool tracking;
  size_t pixels;
  size_t length;
  unsigned long int frame_width;
  unsigned long int frame_height;
  unsigned short int *buffer;
  unsigned short int *shadow;
+ const unsigned short int *backup;
+ unsigned long int saves;
+ Dirty_Regions dirty;
  void calculate_buffer_length();
  unsigned short int *get_memory(const char *error);
  void clear_buffer(unsigned short int *target);
  unsigned short int *create_buffer(const char *error);
+ void copy_span(unsigned short int *target,const unsigned short int *source,const unsigned long int amount,const bool reverse);
+ void blend_span(unsigned short int *target,const unsigned short int *source,const unsigned char *alpha,const unsigned long int amount,const bool reverse,const unsigned char opacity);
  protected:
  size_t get_offset(const unsigned long int x,const unsigned long int y,const unsigned long int target_width);
  size_t get_offset(const unsigned long int x,const unsigned long int y) const;
  void set_size(const unsigned long int surface_width,const unsigned long int surface_height);
  void create_buffers();
  size_t get_length() const;
+ const Dirty_Regions &get_dirty() const;
+ void clear_dirty();
  public:
  Frame();
  ~Frame();
@@ -157,10 +290,25 @@ class Frame
  unsigned long int get_frame_width() const;
  unsigned long int get_frame_height() const;
  bool draw_pixel(const unsigned long int x,const unsigned long int y,const unsigned short int red,const unsigned short int green,const unsigned short int blue);
+ bool draw_pixel(const unsigned long int x,const unsigned long int y,const unsigned short int color);
+ void draw_image(const unsigned long int x,const unsigned long int y,const unsigned long int width,const unsigned long int height,const unsigned short int *source,const unsigned long int stride,const bool horizontal,const bool vertical);
+ void draw_runs(const unsigned long int x,const unsigned long int y,const unsigned long int width,const unsigned long int height,const unsigned short int *source,const unsigned long int stride,const Opaque_Runs &runs,const size_t row,const unsigned long int origin,const bool horizontal,const bool vertical);
+ void draw_scrolled(const unsigned long int width,const unsigned long int height,const unsigned short int *source,const unsigned long int stride,const unsigned long int scroll_x,const unsigned long int scroll_y,const bool horizontal_wrap,const bool vertical_wrap,const bool horizontal,const bool vertical);
+ void draw_scrolled_runs(const unsigned long int width,const unsigned long int height,const unsigned short int *source,const unsigned long int stride,const Opaque_Runs &runs,const size_t row,const unsigned long int scroll_x,const unsigned long int scroll_y,const bool horizontal_wrap,const bool vertical_wrap,const bool horizontal,const bool vertical);
+ void draw_affine(const unsigned long int x,const unsigned long int y,const unsigned long int width,const unsigned long int height,const unsigned short int *source,const unsigned char *alpha,const unsigned long int stride,const double angle,const double scale,const bool keyed,const unsigned short int key,const bool horizontal,const bool vertical);
+ void draw_blended_runs(const unsigned long int x,const unsigned long int y,const unsigned long int width,const unsigned long int height,const unsigned short int *source,const unsigned char *alpha,const unsigned long int stride,const Opaque_Runs &runs,const size_t row,const unsigned long int origin,const unsigned char opacity,const bool horizontal,const bool vertical);
+ void fill_rectangle(const unsigned long int x,const unsigned long int y,const unsigned long int width,const unsigned long int height,const unsigned short int color);
  void clear_screen();
  void save();
  void restore();
  void restore(const unsigned long int x,const unsigned long int y,const unsigned long int width,const unsigned long int height);
+ void restore(const unsigned short int *source);
+ void detach_shadow(const unsigned short int *source);
+ unsigned long int get_saves() const;
+ void set_tracking(const bool enabled);
+ bool get_tracking() const;
+ void invalidate();
+ void invalidate(const unsigned long int x,const unsigned long int y,const unsigned long int width,const unsigned long int height);
 };
 
 class Plane: public Frame
@@ -170,14 +318,25 @@ class Plane: public Frame
  unsigned short int *target;
  unsigned long int target_width;
  unsigned long int target_height;
- float x_ratio;
- float y_ratio;
+ unsigned long int factor;
+ size_t *columns;
+ size_t *rows;
+ void get_factor();
+ size_t *create_table(const unsigned long int amount);
+ void destroy_tables();
+ void fill_table(size_t *table,const unsigned long int source_amount,const unsigned long int target_amount,const size_t stride);
+ void create_tables();
+ void copy_plane();
+ void scale_double();
+ void scale_triple();
+ void scale_plane();
  public:
  Plane();
  ~Plane();
  void create_plane(const unsigned long int width,const unsigned long int height,const unsigned long int surface_width,const unsigned long int surface_height,unsigned short int *surface_buffer);
  void transfer();
  Plane* get_handle();
+ friend class Render;
 };
 
 class Timer
@@ -210,15 +369,87 @@ class Render:public Frame
 {
  private:
  int device;
+ const char *name;
+ bool headless;
+ bool vsync;
+ bool vsync_requested;
+ bool changed;
+ bool async;
+ volatile bool running;
+ volatile bool busy;
  unsigned long int start;
+ unsigned long int page;
+ unsigned long int pages;
+ unsigned long int maximum_pages;
+ unsigned long int virtual_width;
+ unsigned long int virtual_height;
+ unsigned long int virtual_color;
+ PIXEL_FORMAT format;
+ size_t pixel_size;
+ void (*transfer)(unsigned char *target,const unsigned short int *source,const size_t amount);
+ void (*scale)(unsigned char *target,const unsigned short int *source,const size_t *table,const size_t amount);
+ unsigned char *converted;
+ unsigned char *line;
+ Plane *plane;
+ Dirty_Regions whole;
+ size_t memory_length;
+ unsigned char *mapping;
+ unsigned char *memory;
+ Dirty_Regions *stale;
+ unsigned short int *staging;
+ Dirty_Regions pending;
+ pthread_t presenter;
+ pthread_mutex_t guard;
+ pthread_cond_t work;
+ pthread_cond_t done;
+ unsigned long int handoffs;
+ double wait_total;
+ double wait_maximum;
  fb_fix_screeninfo configuration;
  fb_var_screeninfo setting;
+ fb_var_screeninfo original;
+ void read_mode();
+ void open_device();
+ void create_virtual_configuration();
  void read_base_configuration();
  void read_advanced_configuration();
  void read_configuration();
+ void detect_format();
+ void create_converted();
+ void create_line();
  void get_start_offset();
+ size_t get_page_offset(const unsigned long int target) const;
+ bool check_memory() const;
+ void map_memory();
+ void unmap_memory();
+ unsigned long int get_page_capacity() const;
+ void resize_virtual_screen(const unsigned long int amount);
+ bool pan_display(const unsigned long int target);
+ void create_stale_regions();
+ void prepare_pages();
+ void restore_display();
+ void wait_vsync();
+ void flip_page(const unsigned short int *source,const Dirty_Regions &regions);
+ void copy_region(unsigned char *target,const unsigned short int *source,const Dirty_Region &region);
+ bool check_scale() const;
+ void scale_frame(unsigned char *target,const unsigned short int *source,const size_t pitch);
+ void copy_frame(unsigned char *target,const unsigned short int *source);
+ void copy_regions(unsigned char *target,const unsigned short int *source,const Dirty_Regions &regions);
+ void write_band(const unsigned short int *source,const unsigned long int top,const unsigned long int bottom);
+ void write_plane(const unsigned short int *source);
+ void write_frame(const unsigned short int *source,const Dirty_Regions &regions);
+ void present(const unsigned short int *source,const Dirty_Regions &regions);
+ void update_statistic(const double wait);
+ size_t get_source_pixels();
+ void copy_staging();
+ void hand_off();
+ void run_presenter();
+ void create_staging();
+ void start_presenter();
+ void stop_presenter();
  protected:
  void prepare_render();
+ void prepare_presenter();
  void refresh();
  public:
  Render();
@@ -226,6 +457,22 @@ class Render:public Frame
  unsigned long int get_width() const;
  unsigned long int get_height() const;
  unsigned long int get_color() const;
+ PIXEL_FORMAT get_format() const;
+ void set_device(const char *target);
+ void set_mode(const unsigned long int width,const unsigned long int height,const unsigned long int color);
+ bool is_headless() const;
+ void set_pages(const unsigned long int amount);
+ unsigned long int get_pages() const;
+ void set_vsync(const bool enabled);
+ bool get_vsync() const;
+ void set_async(const bool enabled);
+ bool get_async() const;
+ unsigned long int get_handoffs() const;
+ double get_wait_total() const;
+ double get_wait_maximum() const;
+ void set_plane(Plane *target);
+ Plane* get_plane();
+ friend void* present_frames(void *target);
 };
 
 class Screen:public Render,public FPS
@@ -244,6 +491,11 @@ class Gamepad
  unsigned char *current;
  unsigned char *preversion;
  int device;
+ const char *name;
+ bool replay;
+ bool pending;
+ double replay_start;
+ double event_start;
  size_t length;
  input_event input;
  unsigned char *get_memory(const char *message);
@@ -254,9 +506,14 @@ class Gamepad
  unsigned char get_state() const;
  GAMEPAD_BUTTONS get_button() const;
  bool check_state(const GAMEPAD_BUTTONS button,const unsigned char state);
+ double get_event_time() const;
+ void process_event();
+ void read_events();
+ void replay_events();
  public:
  Gamepad();
  ~Gamepad();
+ void set_device(const char *target);
  void initialize();
  void update();
  bool check_hold(const GAMEPAD_BUTTONS button);
@@ -280,9 +537,13 @@ class Sound
 {
  private:
  char *internal;
+ const char *name;
+ bool record;
  size_t buffer_length;
  pthread_t stream;
  void open_device();
+ bool check_sink() const;
+ void prepare_sink(const int rate);
  void set_format();
  void set_channels();
  void set_rate(const int rate);
@@ -293,6 +554,8 @@ class Sound
  public:
  Sound();
  ~Sound();
+ void set_device(const char *target);
+ void set_record(const char *target);
  void initialize(const int rate);
  bool check_busy();
  size_t get_length() const;
@@ -304,6 +567,8 @@ class Mixer
 {
  private:
  int device;
+ const char *name;
+ bool dummy;
  int maximum;
  int minimum;
  int current;
@@ -313,6 +578,7 @@ class Mixer
  public:
  Mixer();
  ~Mixer();
+ void set_device(const char *target);
  void set_volume(const int level);
  void turn_on();
  void turn_off();
@@ -326,6 +592,7 @@ class Backlight
 {
  private:
  FILE *device;
+ const char *name;
  unsigned char minimum;
  unsigned char maximum;
  unsigned char current;
@@ -341,6 +608,7 @@ class Backlight
  public:
  Backlight();
  ~Backlight();
+ void set_device(const char *target);
  unsigned char get_minimum() const;
  unsigned char get_maximum() const;
  unsigned char get_level();
@@ -476,8 +744,10 @@ class Image
  unsigned long int width;
  unsigned long int height;
  unsigned char *data;
+ unsigned char *alpha;
  unsigned char *create_buffer(const size_t length);
  void clear_buffer();
+ void split_alpha(const unsigned char *source);
  public:
  Image();
  ~Image();
@@ -487,36 +757,84 @@ class Image
  unsigned long int get_height() const;
  size_t get_length() const;
  unsigned char *get_data();
+ unsigned char *get_alpha();
  void destroy_image();
 };
 
+class Atlas;
+
+class Image_Storage
+{
+ private:
+ unsigned short int *image;
+ unsigned char *alpha;
+ unsigned long int references;
+ public:
+ Image_Storage();
+ ~Image_Storage();
+ void set_image(unsigned short int *buffer,unsigned char *mask);
+ void acquire();
+ bool release();
+ unsigned long int get_references() const;
+};
+
 class Surface
 {
  private:
  Screen *surface;
- IMG_Pixel *image;
+ Image_Storage *storage;
+ unsigned short int *image;
+ unsigned char *alpha;
  unsigned long int width;
  unsigned long int height;
+ unsigned long int stride;
+ unsigned long int revision;
+ bool exposed;
+ void release_storage();
+ void unshare_image();
  protected:
  void save();
  void restore();
+ void restore(const unsigned short int *source);
+ void detach_shadow(const unsigned short int *source);
+ void invalidate(const unsigned long int x,const unsigned long int y,const unsigned long int width,const unsigned long int height);
  void clear_buffer();
- IMG_Pixel *create_buffer(const unsigned long int image_width,const unsigned long int image_height);
+ unsigned short int *create_buffer(const unsigned long int image_width,const unsigned long int image_height);
+ unsigned char *create_alpha(const unsigned long int image_width,const unsigned long int image_height);
+ unsigned short int *pack_image(Image &buffer);
+ unsigned char *copy_alpha(Image &buffer);
  void set_size(const unsigned long int image_width,const unsigned long int image_height);
- void set_buffer(IMG_Pixel *buffer);
+ void set_buffer(unsigned short int *buffer,unsigned char *mask);
+ void share_image(const Surface &target);
+ void share_region(const Surface &target,const Atlas_Region &region);
+ void repack_image(const size_t *offsets,const unsigned long int amount,const unsigned long int frame_width,const unsigned long int frame_height);
+ const unsigned short int *read_image() const;
+ const unsigned char *read_alpha() const;
  size_t get_offset(const unsigned long int start,const unsigned long int x,const unsigned long int y,const unsigned long int target_width);
  size_t get_offset(const unsigned long int start,const unsigned long int x,const unsigned long int y) const;
  void draw_image_pixel(const size_t offset,const unsigned long int x,const unsigned long int y);
- bool compare_pixels(const size_t first,const size_t second) const;
+ void draw_image_region(const size_t offset,const unsigned long int x,const unsigned long int y,const unsigned long int region_width,const unsigned long int region_height,const bool horizontal,const bool vertical);
+ void draw_image_runs(const size_t offset,const unsigned long int x,const unsigned long int y,const unsigned long int region_width,const unsigned long int region_height,const Opaque_Runs &runs,const size_t row,const unsigned long int origin,const bool horizontal,const bool vertical);
+ void draw_scrolled_image(const size_t offset,const unsigned long int region_width,const unsigned long int region_height,const unsigned long int scroll_x,const unsigned long int scroll_y,const bool horizontal_wrap,const bool vertical_wrap,const bool horizontal,const bool vertical);
+ void draw_scrolled_runs(const size_t offset,const unsigned long int region_width,const unsigned long int region_height,const Opaque_Runs &runs,const size_t row,const unsigned long int scroll_x,const unsigned long int scroll_y,const bool horizontal_wrap,const bool vertical_wrap,const bool horizontal,const bool vertical);
+ void draw_transformed_image(const size_t offset,const unsigned long int x,const unsigned long int y,const unsigned long int region_width,const unsigned long int region_height,const double angle,const double scale,const bool keyed,const unsigned short int key,const bool horizontal,const bool vertical);
+ void draw_blended_image(const size_t offset,const unsigned long int x,const unsigned long int y,const unsigned long int region_width,const unsigned long int region_height,const Opaque_Runs &runs,const size_t row,const unsigned long int origin,const unsigned char opacity,const bool horizontal,const bool vertical);
  unsigned long int get_surface_width() const;
  unsigned long int get_surface_height() const;
+ unsigned long int get_stride() const;
+ unsigned long int get_revision() const;
+ unsigned long int get_saves() const;
  public:
  Surface();
  ~Surface();
  void initialize(Screen *screen);
  size_t get_length() const;
- IMG_Pixel *get_image();
+ unsigned short int *get_image();
+ unsigned char *get_alpha();
+ void release_image();
+ unsigned long int get_references() const;
  void load_image(Image &buffer);
+ void load_image(Atlas &atlas,const unsigned long int index);
  unsigned long int get_image_width() const;
  unsigned long int get_image_height() const;
  void mirror_image(const MIRROR_TYPE kind);
@@ -530,10 +848,21 @@ class Animation
  private:
  unsigned long int frames;
  unsigned long int frame;
+ unsigned long int amount;
+ size_t *table;
+ void destroy_table();
+ void update_start();
  protected:
  unsigned long int start;
+ unsigned long int grid_columns;
+ unsigned long int grid_rows;
  void set_frame(const unsigned long int target);
  void increase_frame();
+ void create_table(const unsigned long int columns,const unsigned long int rows,const unsigned long int frame_width,const unsigned long int frame_height,const unsigned long int stride);
+ unsigned long int get_table_size() const;
+ unsigned long int get_position() const;
+ size_t get_frame_offset(const unsigned long int index) const;
+ const size_t *get_frame_table() const;
  public:
  Animation();
  ~Animation();
@@ -550,11 +879,42 @@ class Background:public Surface,public Animation
  unsigned long int maximum_width;
  unsigned long int maximum_height;
  unsigned long int current;
+ unsigned long int scroll_x;
+ unsigned long int scroll_y;
  BACKGROUND_TYPE current_kind;
+ bool horizontal_flip;
+ bool vertical_flip;
+ bool horizontal_wrap;
+ bool vertical_wrap;
+ bool transparent;
+ bool encoded;
+ bool custom_key;
+ unsigned short int key;
+ unsigned short int encoded_key;
+ unsigned long int encoded_revision;
+ unsigned long int encoded_frames;
+ unsigned long int table_revision;
+ unsigned long int cache_revision;
+ unsigned long int saves;
+ unsigned short int **cache;
+ size_t cache_amount;
+ size_t cache_used;
+ size_t cache_limit;
+ Opaque_Runs runs;
+ void resolve_key();
+ bool check_runs() const;
+ void encode_runs();
+ void destroy_cache();
+ void create_cache(const size_t amount);
+ void convert_frame(const unsigned long int index,unsigned short int *target);
+ void fill_cache();
+ void prepare_cache();
  void get_maximum_width();
  void get_maximum_height();
+ unsigned long int move_offset(const unsigned long int offset,const long int delta,const unsigned long int length,const bool wrap) const;
  void slow_draw_background();
  void configure_background();
+ void check_table();
  public:
  Background();
  ~Background();
@@ -563,27 +923,87 @@ class Background:public Surface,public Animation
  void set_kind(const BACKGROUND_TYPE kind);
  void set_setting(const BACKGROUND_TYPE kind,const unsigned long int frames);
  void set_target(const unsigned long int target);
+ void set_grid(const unsigned long int columns,const unsigned long int rows);
+ void repack_frames();
  void step();
+ void horizontal_mirror();
+ void vertical_mirror();
+ bool get_horizontal_mirror() const;
+ bool get_vertical_mirror() const;
+ void set_wrap(const bool horizontal,const bool vertical);
+ bool get_horizontal_wrap() const;
+ bool get_vertical_wrap() const;
+ void set_offset(const unsigned long int x,const unsigned long int y);
+ void scroll(const long int x,const long int y);
+ unsigned long int get_offset_x() const;
+ unsigned long int get_offset_y() const;
+ void set_transparent(const bool enabled);
+ bool get_transparent() const;
+ void set_color_key(const unsigned short int red,const unsigned short int green,const unsigned short int blue);
+ void reset_color_key();
+ unsigned short int get_color_key() const;
+ void set_cache_limit(const size_t limit);
+ size_t get_cache_limit() const;
+ size_t get_cache_usage() const;
+ void draw_layer();
  void draw_background();
+ friend class Parallax;
 };
 
 class Sprite:public Surface,public Animation
 {
  private:
  bool transparent;
+ bool horizontal_flip;
+ bool vertical_flip;
+ bool encoded;
+ bool encoded_keyed;
+ bool custom_key;
+ unsigned char opacity;
+ unsigned short int key;
+ unsigned short int encoded_key;
  unsigned long int current_x;
  unsigned long int current_y;
  unsigned long int sprite_width;
  unsigned long int sprite_height;
+ unsigned long int encoded_revision;
+ unsigned long int encoded_frames;
+ unsigned long int encoded_width;
+ unsigned long int table_revision;
  SPRITE_TYPE current_kind;
+ SPRITE_TYPE encoded_kind;
+ Opaque_Runs runs;
+ Collision_Mask mask;
+ Collision_Box *bounds;
+ void destroy_bounds();
+ void create_bounds(const unsigned long int frames);
+ Collision_Box get_bounds() const;
+ void resolve_key();
+ bool check_keyed() const;
+ bool check_runs() const;
+ void encode_runs();
+ void prepare_runs();
+ void configure_kind(const SPRITE_TYPE kind);
+ void check_table();
  void draw_transparent_sprite();
  void draw_normal_sprite();
+ void draw_blended_sprite();
+ const unsigned int *get_mask_row(const unsigned long int y) const;
  public:
  Sprite();
  ~Sprite();
  void load_sprite(Image &buffer,const SPRITE_TYPE kind,const unsigned long int frames);
+ void load_sprite(Atlas &atlas,const unsigned long int index,const SPRITE_TYPE kind,const unsigned long int frames);
+ void load_sheet(Image &buffer,const unsigned long int columns,const unsigned long int rows);
+ void load_sheet(Atlas &atlas,const unsigned long int index,const unsigned long int columns,const unsigned long int rows);
+ void repack_frames();
  void set_transparent(const bool enabled);
  bool get_transparent() const;
+ void set_color_key(const unsigned short int red,const unsigned short int green,const unsigned short int blue);
+ void reset_color_key();
+ unsigned short int get_color_key() const;
+ void set_opacity(const unsigned char amount);
+ unsigned char get_opacity() const;
  void set_x(const unsigned long int x);
  void set_y(const unsigned long int y);
  void increase_x();
@@ -600,16 +1020,24 @@ class Sprite:public Surface,public Animation
  unsigned long int get_height() const;
  Sprite* get_handle();
  Collision_Box get_box() const;
+ Collision_Box get_opaque_box();
+ bool check_pixel_collision(Sprite &target);
  void set_kind(const SPRITE_TYPE kind);
  SPRITE_TYPE get_kind() const;
  void set_target(const unsigned long int target);
  void step();
  void set_position(const unsigned long int x,const unsigned long int y);
+ void horizontal_mirror();
+ void vertical_mirror();
+ bool get_horizontal_mirror() const;
+ bool get_vertical_mirror() const;
  void clone(Sprite &target);
  void draw_sprite();
  void draw_sprite(const unsigned long int x,const unsigned long int y);
  void draw_sprite(const bool transparency);
  void draw_sprite(const bool transparency,const unsigned long int x,const unsigned long int y);
+ void draw_rotated_sprite(const double angle,const double scale);
+ void draw_rotated_sprite(const double angle,const double scale,const unsigned long int x,const unsigned long int y);
 };
 
 class Tileset:public Surface
@@ -633,6 +1061,34 @@ class Tileset:public Surface
  void load_tileset(Image &buffer,const unsigned long int row_amount,const unsigned long int column_amount);
 };
 
+class Atlas:public Surface
+{
+ private:
+ Atlas_Region *regions;
+ unsigned short int **images;
+ unsigned char **masks;
+ size_t amount;
+ size_t capacity;
+ bool packed;
+ void grow_list();
+ void destroy_pending();
+ unsigned long int get_atlas_width() const;
+ size_t *sort_regions();
+ void place_regions(const size_t *order,const unsigned long int atlas_width);
+ unsigned long int get_atlas_height() const;
+ void copy_regions(unsigned short int *target,unsigned char *mask,const unsigned long int atlas_width);
+ public:
+ Atlas();
+ ~Atlas();
+ unsigned long int add_image(Image &buffer);
+ unsigned long int add_tga(const char *name);
+ unsigned long int add_pcx(const char *name);
+ void pack();
+ bool is_packed() const;
+ unsigned long int get_amount() const;
+ Atlas_Region get_region(const unsigned long int index) const;
+};
+
 class Text
 {
  private:
@@ -670,4 +1126,33 @@ class Collision
  Collision_Box generate_box(const unsigned long int x,const unsigned long int y,const unsigned long int width,const unsigned long int height) const;
 };
 
+
+class Parallax
+{
+ private:
+ Screen *surface;
+ Background **targets;
+ Parallax_Layer *layers;
+ size_t amount;
+ size_t capacity;
+ size_t saved;
+ unsigned long int saves;
+ unsigned long int camera_x;
+ unsigned long int camera_y;
+ void destroy_layers();
+ void grow_layers();
+ bool check_layer(const size_t index) const;
+ void update_layer(const size_t index);
+ public:
+ Parallax();
+ ~Parallax();
+ void initialize(Screen *screen);
+ void add_layer(Background &target,const double factor_x,const double factor_y);
+ size_t get_amount() const;
+ void set_camera(const unsigned long int x,const unsigned long int y);
+ unsigned long int get_camera_x() const;
+ unsigned long int get_camera_y() const;
+ void draw_layers();
+};
+
 }
\ No newline at end of file
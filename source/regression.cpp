@@ -0,0 +1,398 @@
+#include "dinguxgdk.h"
+
+#define SPRITE_WIDTH 24
+#define SPRITE_HEIGHT 16
+#define LAYER_WIDTH 64
+#define LAYER_HEIGHT 48
+#define BACK_COLOR 0x0841
+
+const char FRAME_FILE[]="regression_frame.raw";
+const char SPRITE_FILE[]="regression_sprite.tga";
+const char BLOCK_FILE[]="regression_block.tga";
+const char LAYER_FILE[]="regression_layer.tga";
+const char CACHE_FILE[]="regression_cache.tga";
+
+unsigned long int failures=0;
+
+void check(const char *name,const bool result)
+{
+ if (result==true)
+ {
+  printf("PASS %s\n",name);
+ }
+ else
+ {
+  printf("FAIL %s\n",name);
+  ++failures;
+ }
+
+}
+
+unsigned short int pack_color(const unsigned char red,const unsigned char green,const unsigned char blue)
+{
+ return (blue>>3)+((green>>2)<<5)+((red>>3)<<11);
+}
+
+bool check_key(const unsigned long int x,const unsigned long int y)
+{
+ return ((x+2*y)%7)==0;
+}
+
+void get_pattern(const unsigned long int x,const unsigned long int y,unsigned char *pixel)
+{
+ pixel[0]=static_cast<unsigned char>((x*5+y*9)%256);
+ pixel[1]=static_cast<unsigned char>((y*12)%240+8);
+ pixel[2]=static_cast<unsigned char>((x*24)%256);
+}
+
+unsigned short int get_pixel(const unsigned long int x,const unsigned long int y)
+{
+ unsigned char pixel[3];
+ get_pattern(x,y,pixel);
+ return pack_color(pixel[2],pixel[1],pixel[0]);
+}
+
+void write_tga(const char *name,const unsigned long int width,const unsigned long int height,const bool keyed,const bool block)
+{
+ FILE *target;
+ unsigned char head[18];
+ unsigned char pixel[3];
+ unsigned long int x,y;
+ target=fopen(name,"wb");
+ if (target==NULL)
+ {
+  puts("Can't create test image");
+  exit(EXIT_FAILURE);
+ }
+ memset(head,0,18);
+ head[2]=2;
+ head[12]=width%256;
+ head[13]=width/256;
+ head[14]=height%256;
+ head[15]=height/256;
+ head[16]=24;
+ fwrite(head,1,18,target);
+ for (y=0;y<height;++y)
+ {
+  for (x=0;x<width;++x)
+  {
+   get_pattern(x,y,pixel);
+   if ((keyed==true)&&(check_key(x,y)==true))
+   {
+    pixel[0]=255;
+    pixel[1]=0;
+    pixel[2]=255;
+   }
+   if (block==true)
+   {
+    pixel[0]=50;
+    pixel[1]=100;
+    pixel[2]=200;
+    if (x>=width/2)
+    {
+     pixel[0]=255;
+     pixel[1]=0;
+     pixel[2]=255;
+    }
+
+   }
+   fwrite(pixel,1,3,target);
+  }
+
+ }
+ fclose(target);
+}
+
+void fill_screen(DINGUXGDK::Screen &screen)
+{
+ size_t index;
+ for (index=0;index<screen.get_pixels();++index)
+ {
+  screen.get_buffer()[index]=BACK_COLOR;
+ }
+ screen.invalidate();
+}
+
+bool check_sprite(DINGUXGDK::Screen &screen,const unsigned long int x,const unsigned long int y,const bool transparent,const bool horizontal,const bool vertical)
+{
+ unsigned long int sprite_x,sprite_y,source_x,source_y,target_x,target_y;
+ unsigned short int expected;
+ bool result;
+ result=true;
+ for (target_y=0;target_y<screen.get_frame_height();++target_y)
+ {
+  for (target_x=0;target_x<screen.get_frame_width();++target_x)
+  {
+   expected=BACK_COLOR;
+   if ((target_x>=x)&&(target_y>=y)&&(target_x-x<SPRITE_WIDTH)&&(target_y-y<SPRITE_HEIGHT))
+   {
+    sprite_x=target_x-x;
+    sprite_y=target_y-y;
+    source_x=sprite_x;
+    source_y=sprite_y;
+    if (horizontal==true) source_x=SPRITE_WIDTH-sprite_x-1;
+    if (vertical==true) source_y=SPRITE_HEIGHT-sprite_y-1;
+    source_x+=SPRITE_WIDTH;
+    if ((transparent==false)||(check_key(source_x,source_y)==false))
+    {
+     expected=get_pixel(source_x,source_y);
+     if (check_key(source_x,source_y)==true) expected=pack_color(255,0,255);
+    }
+
+   }
+   if (screen.get_buffer()[target_x+target_y*screen.get_frame_width()]!=expected) result=false;
+  }
+
+ }
+ return result;
+}
+
+void test_sprites(DINGUXGDK::Screen &screen,DINGUXGDK::Image &image)
+{
+ DINGUXGDK::Sprite sprite;
+ unsigned long int x[3],y[3],index,flip;
+ bool result;
+ x[0]=5;
+ y[0]=7;
+ x[1]=screen.get_frame_width()-10;
+ y[1]=screen.get_frame_height()-6;
+ x[2]=screen.get_frame_width()-SPRITE_WIDTH;
+ y[2]=0;
+ image.load_tga(SPRITE_FILE);
+ sprite.initialize(screen.get_handle());
+ sprite.load_sprite(image,HORIZONTAL_STRIP,2);
+ sprite.set_target(2);
+ result=true;
+ for (flip=0;flip<4;++flip)
+ {
+  if ((flip%2)!=(sprite.get_horizontal_mirror()==true)) sprite.horizontal_mirror();
+  if ((flip/2)!=(sprite.get_vertical_mirror()==true)) sprite.vertical_mirror();
+  for (index=0;index<3;++index)
+  {
+   fill_screen(screen);
+   sprite.draw_sprite(true,x[index],y[index]);
+   if (check_sprite(screen,x[index],y[index],true,flip%2==1,flip/2==1)==false) result=false;
+   fill_screen(screen);
+   sprite.draw_sprite(false,x[index],y[index]);
+   if (check_sprite(screen,x[index],y[index],false,flip%2==1,flip/2==1)==false) result=false;
+  }
+
+ }
+ check("sprite clipping, flips and color key",result);
+ if (sprite.get_horizontal_mirror()==true) sprite.horizontal_mirror();
+ if (sprite.get_vertical_mirror()==true) sprite.vertical_mirror();
+ sprite.set_transparent(true);
+ fill_screen(screen);
+ sprite.draw_rotated_sprite(0,1,x[0],y[0]);
+ check("sprite rotation at angle 0",check_sprite(screen,x[0],y[0],true,false,false));
+}
+
+void test_collision(DINGUXGDK::Screen &screen,DINGUXGDK::Image &image)
+{
+ DINGUXGDK::Sprite first,second;
+ bool result;
+ image.load_tga(BLOCK_FILE);
+ first.initialize(screen.get_handle());
+ second.initialize(screen.get_handle());
+ first.load_sprite(image,SINGLE_SPRITE,1);
+ second.load_sprite(image,SINGLE_SPRITE,1);
+ first.set_color_key(255,0,255);
+ second.set_color_key(255,0,255);
+ first.set_position(10,10);
+ second.set_position(18,10);
+ result=first.check_pixel_collision(second)==false;
+ second.set_position(14,12);
+ if (first.check_pixel_collision(second)==false) result=false;
+ second.horizontal_mirror();
+ second.set_position(2,10);
+ if (first.check_pixel_collision(second)==false) result=false;
+ second.set_position(18,10);
+ if (first.check_pixel_collision(second)==true) result=false;
+ check("pixel collision",result);
+}
+
+void test_scrolling(DINGUXGDK::Screen &screen,DINGUXGDK::Image &image)
+{
+ DINGUXGDK::Background layer;
+ unsigned long int x,y,source_x,source_y;
+ bool result;
+ image.load_tga(LAYER_FILE);
+ layer.initialize(screen.get_handle());
+ layer.load_image(image);
+ layer.set_setting(NORMAL_BACKGROUND,1);
+ layer.set_wrap(true,true);
+ layer.horizontal_mirror();
+ layer.set_offset(10,7);
+ layer.scroll(-20,50);
+ fill_screen(screen);
+ layer.draw_background();
+ result=true;
+ for (y=0;y<screen.get_frame_height();++y)
+ {
+  for (x=0;x<screen.get_frame_width();++x)
+  {
+   source_x=LAYER_WIDTH-1-(x+LAYER_WIDTH-10)%LAYER_WIDTH;
+   source_y=(y+57)%LAYER_HEIGHT;
+   if (screen.get_buffer()[x+y*screen.get_frame_width()]!=get_pixel(source_x,source_y)) result=false;
+  }
+
+ }
+ check("wrapped and mirrored scrolling",result);
+}
+
+bool check_frame(DINGUXGDK::Screen &screen,const unsigned long int frame)
+{
+ unsigned long int x,y;
+ bool result;
+ result=true;
+ for (y=0;y<screen.get_frame_height();++y)
+ {
+  for (x=0;x<screen.get_frame_width();++x)
+  {
+   if (screen.get_buffer()[x+y*screen.get_frame_width()]!=get_pixel(x,y+frame*screen.get_frame_height())) result=false;
+  }
+
+ }
+ return result;
+}
+
+void test_cache(DINGUXGDK::Screen &screen,DINGUXGDK::Image &image)
+{
+ DINGUXGDK::Background layer;
+ unsigned long int index;
+ bool result;
+ image.load_tga(CACHE_FILE);
+ layer.initialize(screen.get_handle());
+ layer.load_image(image);
+ layer.set_setting(VERTICAL_BACKGROUND,2);
+ result=true;
+ for (index=0;index<5;++index)
+ {
+  layer.set_target(1+index%2);
+  fill_screen(screen);
+  layer.draw_background();
+  if (check_frame(screen,index%2)==false) result=false;
+  fill_screen(screen);
+  screen.restore();
+  if (check_frame(screen,index%2)==false) result=false;
+ }
+ if (layer.get_cache_usage()!=2*screen.get_pixels()*sizeof(unsigned short int)) result=false;
+ check("background cache and restore",result);
+}
+
+void test_atlas(DINGUXGDK::Screen &screen)
+{
+ DINGUXGDK::Atlas atlas;
+ DINGUXGDK::Sprite sprite;
+ atlas.add_tga(BLOCK_FILE);
+ atlas.add_tga(SPRITE_FILE);
+ atlas.pack();
+ sprite.initialize(screen.get_handle());
+ sprite.load_sprite(atlas,1,HORIZONTAL_STRIP,2);
+ sprite.set_target(2);
+ sprite.horizontal_mirror();
+ fill_screen(screen);
+ sprite.draw_sprite(true,30,40);
+ check("atlas sprite",check_sprite(screen,30,40,true,true,false));
+}
+
+bool compare_device(DINGUXGDK::Screen &screen,unsigned short int *target)
+{
+ FILE *source;
+ bool result;
+ result=false;
+ source=fopen(FRAME_FILE,"rb");
+ if (source!=NULL)
+ {
+  if (fread(target,sizeof(unsigned short int),screen.get_pixels(),source)==screen.get_pixels())
+  {
+   result=memcmp(target,screen.get_buffer(),screen.get_pixels()*sizeof(unsigned short int))==0;
+  }
+  fclose(source);
+ }
+ return result;
+}
+
+void test_present(DINGUXGDK::Screen &screen,DINGUXGDK::Image &image)
+{
+ DINGUXGDK::Background layer;
+ DINGUXGDK::Sprite sprite;
+ unsigned short int *frame;
+ unsigned short int marker;
+ unsigned long int index;
+ int device;
+ bool result;
+ frame=new unsigned short int[screen.get_pixels()];
+ image.load_tga(CACHE_FILE);
+ layer.initialize(screen.get_handle());
+ layer.load_image(image);
+ layer.set_setting(VERTICAL_BACKGROUND,2);
+ image.load_tga(SPRITE_FILE);
+ sprite.initialize(screen.get_handle());
+ sprite.load_sprite(image,HORIZONTAL_STRIP,2);
+ screen.set_pages(1);
+ screen.set_tracking(true);
+ layer.draw_background();
+ screen.update();
+ result=compare_device(screen,frame);
+ marker=0xAAAA;
+ device=open(FRAME_FILE,O_WRONLY);
+ if (device!=-1)
+ {
+  for (index=0;index<screen.get_pixels();++index)
+  {
+   if (pwrite(device,&marker,sizeof(unsigned short int),index*sizeof(unsigned short int))!=sizeof(unsigned short int)) result=false;
+  }
+  close(device);
+ }
+ sprite.draw_sprite(false,40,50);
+ screen.update();
+ compare_device(screen,frame);
+ if (frame[40+50*screen.get_frame_width()]!=screen.get_buffer()[40+50*screen.get_frame_width()]) result=false;
+ if (frame[39+50*screen.get_frame_width()]!=marker) result=false;
+ if (frame[40+(50+SPRITE_HEIGHT)*screen.get_frame_width()]!=marker) result=false;
+ layer.set_target(2);
+ layer.draw_background();
+ screen.update();
+ if (compare_device(screen,frame)==false) result=false;
+ check("dirty region present",result);
+ screen.set_tracking(false);
+ screen.set_async(true);
+ for (index=0;index<8;++index)
+ {
+  layer.set_target(1+index%2);
+  layer.draw_background();
+  sprite.draw_sprite(true,index*20,index*10);
+  screen.update();
+ }
+ screen.set_async(false);
+ result=(screen.get_handoffs()>0)&&(compare_device(screen,frame)==true);
+ check("async present",result);
+ delete[] frame;
+}
+
+int main()
+{
+ DINGUXGDK::Screen screen;
+ DINGUXGDK::Image image;
+ screen.set_device(FRAME_FILE);
+ screen.set_mode(320,240,16);
+ screen.initialize();
+ write_tga(SPRITE_FILE,2*SPRITE_WIDTH,SPRITE_HEIGHT,true,false);
+ write_tga(BLOCK_FILE,16,8,false,true);
+ write_tga(LAYER_FILE,LAYER_WIDTH,LAYER_HEIGHT,false,false);
+ write_tga(CACHE_FILE,screen.get_frame_width(),2*screen.get_frame_height(),false,false);
+ test_sprites(screen,image);
+ test_collision(screen,image);
+ test_scrolling(screen,image);
+ test_cache(screen,image);
+ test_atlas(screen);
+ test_present(screen,image);
+ remove(SPRITE_FILE);
+ remove(BLOCK_FILE);
+ remove(LAYER_FILE);
+ remove(CACHE_FILE);
+ remove(FRAME_FILE);
+ printf("%lu failures\n",failures);
+ return failures==0 ? EXIT_SUCCESS:EXIT_FAILURE;
+}